@@ -0,0 +1,240 @@
+/**
+  * @file channel.c
+  * @author Jake Donovan (jmpatte8)
+  * This file is responsible for the client side of the connection to the lights out server. Every client makes its own
+  * response queue named after its pid and registers it with the server, so any number of clients can talk to the server
+  * at once and each one only ever sees its own responses. A client can instead make a pair of rings in shared memory
+  * named after its pid, then it only uses the server queue to register and every request and response after that is
+  * a copy into shared memory.
+*/
+
+#include "channel.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+// Seconds to wait for the server to answer a registration before we give up on it.
+#define REGISTER_TIMEOUT 2
+
+// Milliseconds to wait for room in our request ring to say we're leaving.
+#define UNREGISTER_TIMEOUT 100
+
+// Seconds to wait for a request to be sent and answered before we decide the server is gone.
+#define TRANSACT_TIMEOUT 5
+
+/**
+  * Milliseconds left until a deadline.
+  * @param deadline a CLOCK_REALTIME time
+  * @return milliseconds, 0 if it has passed
+*/
+static int msUntil( struct timespec const *deadline ) {
+  struct timespec now;
+  clock_gettime( CLOCK_REALTIME, &now );
+  long long ms = ( deadline->tv_sec - now.tv_sec ) * 1000LL + ( deadline->tv_nsec - now.tv_nsec ) / 1000000;
+  return ms > 0 ? ms : 0;
+}
+
+/**
+  * Send a request that has no commands.
+  * @param chan the channel
+  * @param kind KIND_REGISTER, KIND_REGISTER_SHM or KIND_UNREGISTER
+  * @return true if it was sent
+*/
+static bool sendKind( Channel *chan, int kind ) {
+  Request request;
+  request.pid = chan->pid;
+  request.seq = 0;
+  request.kind = kind;
+  request.count = 0;
+  return mq_send( chan->serverQueue, ( char * ) &request, REQUEST_SIZE( 0 ), 0 ) == 0;
+}
+
+/**
+  * Make our rings in shared memory, ready for the server to map.
+  * @param chan the channel
+  * @return true if they were made
+*/
+static bool makeRings( Channel *chan ) {
+  snprintf( chan->ringName, sizeof( chan->ringName ), "%s%d", RING_PREFIX, chan->pid );
+
+  // rings left behind by an earlier process with our pid could still have old messages in them
+  shm_unlink( chan->ringName );
+
+  int fd = shm_open( chan->ringName, O_RDWR | O_CREAT | O_EXCL, 0600 );
+  if( fd == -1 ) {
+    return false;
+  }
+
+  if( ftruncate( fd, sizeof( RingPair ) ) != 0 ) {
+    close( fd );
+    return false;
+  }
+
+  void *addr = mmap( NULL, sizeof( RingPair ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  close( fd );
+  if( addr == MAP_FAILED ) {
+    return false;
+  }
+
+  chan->rings = ( RingPair * ) addr;
+  initRing( &chan->rings->request );
+  initRing( &chan->rings->response );
+  return true;
+}
+
+bool parseTransport( char const *arg, int *transport ) {
+  if( strcmp( arg, "--transport=mq" ) == 0 ) {
+    *transport = TRANSPORT_MQ;
+    return true;
+  }
+
+  if( strcmp( arg, "--transport=shm" ) == 0 ) {
+    *transport = TRANSPORT_SHM;
+    return true;
+  }
+
+  return false;
+}
+
+bool openChannel( Channel *chan, int transport ) {
+  chan->transport = transport;
+  chan->pid = getpid();
+  chan->seq = 0;
+  chan->replyQueue = -1;
+  chan->rings = NULL;
+  chan->replyName[ 0 ] = '\0';
+  chan->ringName[ 0 ] = '\0';
+
+  chan->serverQueue = mq_open( SERVER_QUEUE, O_WRONLY );
+  if( chan->serverQueue == -1 ) {
+    return false;
+  }
+
+  // the server acknowledges with an empty response, or a single error if it has no room for us
+  union {
+    Response response;
+    char raw[ MESSAGE_LIMIT ];
+  } msg;
+  int len;
+
+  if( transport == TRANSPORT_SHM ) {
+    if( !makeRings( chan ) || !sendKind( chan, KIND_REGISTER_SHM ) ) {
+      closeChannel( chan );
+      return false;
+    }
+
+    len = ringReceive( &chan->rings->response, msg.raw, REGISTER_TIMEOUT * 1000 );
+  }
+
+  else {
+    snprintf( chan->replyName, sizeof( chan->replyName ), "%s%d", CLIENT_QUEUE_PREFIX, chan->pid );
+
+    // a queue left behind by an earlier process with our pid could still have old responses in it
+    mq_unlink( chan->replyName );
+
+    struct mq_attr attr;
+    attr.mq_flags = 0;
+    attr.mq_maxmsg = QUEUE_DEPTH;
+    attr.mq_msgsize = MESSAGE_LIMIT;
+    chan->replyQueue = mq_open( chan->replyName, O_RDONLY | O_CREAT, 0600, &attr );
+    if( chan->replyQueue == -1 || !sendKind( chan, KIND_REGISTER ) ) {
+      closeChannel( chan );
+      return false;
+    }
+
+    struct timespec deadline;
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    deadline.tv_sec += REGISTER_TIMEOUT;
+    len = mq_timedreceive( chan->replyQueue, msg.raw, sizeof( msg.raw ), NULL, &deadline );
+  }
+
+  if( len < ( int ) RESPONSE_SIZE( 0 ) || msg.response.count != 0 ) {
+    closeChannel( chan );
+    return false;
+  }
+
+  return true;
+}
+
+bool transact( Channel *chan, Request *request, Response *response ) {
+  request->pid = chan->pid;
+  request->seq = ++chan->seq;
+  request->kind = KIND_COMMANDS;
+
+  union {
+    Response response;
+    char raw[ MESSAGE_LIMIT ];
+  } msg;
+  int len;
+
+  // a server that died would leave us waiting forever
+  struct timespec deadline;
+  clock_gettime( CLOCK_REALTIME, &deadline );
+  deadline.tv_sec += TRANSACT_TIMEOUT;
+  if( chan->transport == TRANSPORT_SHM ) {
+    if( !ringSend( &chan->rings->request, request, REQUEST_SIZE( request->count ), msUntil( &deadline ) ) ) {
+      return false;
+    }
+  }
+
+  else if( mq_timedsend( chan->serverQueue, ( char * ) request, REQUEST_SIZE( request->count ), 0, &deadline ) ) {
+    return false;
+  }
+
+  // the response to a request we gave up on can still turn up ahead of ours, it isn't ours so we skip it
+  do {
+    if( chan->transport == TRANSPORT_SHM ) {
+      len = ringReceive( &chan->rings->response, msg.raw, msUntil( &deadline ) );
+    }
+
+    else {
+      len = mq_timedreceive( chan->replyQueue, msg.raw, sizeof( msg.raw ), NULL, &deadline );
+    }
+  } while( len >= ( int ) RESPONSE_SIZE( 0 ) && msg.response.seq != request->seq );
+
+  if( len < ( int ) RESPONSE_SIZE( request->count ) || msg.response.seq != request->seq ||
+      msg.response.count != request->count ) {
+    return false;
+  }
+
+  memcpy( response, &msg.response, RESPONSE_SIZE( request->count ) );
+  return true;
+}
+
+void closeChannel( Channel *chan ) {
+  if( chan->rings ) {
+    // the server stops serving our rings when it reads this, it keeps its own mapping until then
+    Request request;
+    request.pid = chan->pid;
+    request.seq = 0;
+    request.kind = KIND_UNREGISTER;
+    request.count = 0;
+    ringSend( &chan->rings->request, &request, REQUEST_SIZE( 0 ), UNREGISTER_TIMEOUT );
+    munmap( chan->rings, sizeof( RingPair ) );
+    chan->rings = NULL;
+  }
+
+  if( chan->ringName[ 0 ] ) {
+    shm_unlink( chan->ringName );
+  }
+
+  if( chan->serverQueue != -1 ) {
+    if( chan->transport == TRANSPORT_MQ ) {
+      sendKind( chan, KIND_UNREGISTER );
+    }
+    mq_close( chan->serverQueue );
+  }
+
+  if( chan->replyQueue != -1 ) {
+    mq_close( chan->replyQueue );
+  }
+
+  if( chan->replyName[ 0 ] ) {
+    mq_unlink( chan->replyName );
+  }
+}
@@ -0,0 +1,75 @@
+/**
+  * @file channel.h
+  * @author Jake Donovan (jmpatte8)
+  * Header for the client side of the connection to the lights out server, used by client.c and mqbench.c.
+*/
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "common.h"
+#include "ring.h"
+#include <stdbool.h>
+#include <mqueue.h>
+
+// Ways a client can talk to the server, picked with --transport=mq or --transport=shm.
+#define TRANSPORT_MQ 0
+#define TRANSPORT_SHM 1
+
+// Room for the name of a client's rings, the prefix plus any pid.
+#define RING_NAME CLIENT_QUEUE_NAME
+
+// A client's connection to the server.
+typedef struct {
+  // TRANSPORT_MQ or TRANSPORT_SHM
+  int transport;
+  // our pid, sent with every request
+  int pid;
+  // seq of the last request we sent
+  uint32_t seq;
+  // queue the server reads requests from, with shm it is only used to register
+  mqd_t serverQueue;
+  // our own queue the server sends responses to, only used with mq
+  mqd_t replyQueue;
+  // name of replyQueue, so we can remove it when we're done
+  char replyName[ CLIENT_QUEUE_NAME ];
+  // our rings shared with the server, only used with shm
+  RingPair *rings;
+  // name of the shared memory holding rings, so we can remove it when we're done
+  char ringName[ RING_NAME ];
+} Channel;
+
+/**
+  * Read a --transport=mq or --transport=shm option.
+  * @param arg the command line argument
+  * @param transport where to store TRANSPORT_MQ or TRANSPORT_SHM
+  * @return true if arg was a transport option
+*/
+bool parseTransport( char const *arg, int *transport );
+
+/**
+  * Create our response queue (or our rings) and register with the server.
+  * @param chan the channel to open
+  * @param transport TRANSPORT_MQ or TRANSPORT_SHM
+  * @return true if the server accepted us
+*/
+bool openChannel( Channel *chan, int transport );
+
+/**
+  * Send the commands in a request to the server and wait for the response, giving up if the server takes more than a
+  * few seconds to make room for the request or to answer it. Responses to earlier requests we gave up on are thrown
+  * away.
+  * @param chan an open channel
+  * @param request the commands, the pid and kind are filled in here
+  * @param response where to store the results
+  * @return true if we got a response with a result for every command, false if sending failed or we gave up
+*/
+bool transact( Channel *chan, Request *request, Response *response );
+
+/**
+  * Unregister with the server and remove our response queue or rings.
+  * @param chan an open channel
+*/
+void closeChannel( Channel *chan );
+
+#endif
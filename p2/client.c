@@ -2,10 +2,10 @@
   * @file client.c
   * @author Jake Donovan
   * This file is responsible for sending messages to the client to determine if each option (aka a move, undo, etc) is valid
-  * with the current board via the server's response.
+  * with the current board via the server's response. Compile with channel.c.
 */
 
-#include "common.h"
+#include "channel.h"
 #include <stdlib.h>
 #include <stdbool.h>
 #include <unistd.h>
@@ -17,14 +17,126 @@
 #include <errno.h>
 #include <string.h>
 
+// Print out an error message and exit.
+static void fail( char const *message ) {
+  fprintf( stderr, "%s\n", message );
+  exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+  fprintf( stderr, "usage: client [--transport=shm|mq] <command> ...\n" );
+  fprintf( stderr, "  where each command is one of: move <r> <c>, undo, report\n" );
+  exit( 1 );
+}
+
+/**
+  * Parse the command line into a request, one Command per command given.
+  * @param argc the number of command line arguments
+  * @param argv the command line arguments
+  * @param idx index of the first command
+  * @param request where to store the commands
+*/
+static void parseCommands( int argc, char *argv[], int idx, Request *request ) {
+  request->count = 0;
+  while( idx < argc ) {
+    if( request->count == BATCH_LIMIT ) {
+      fail( "Too many commands" );
+    }
+
+    Command *cmd = &request->cmd[ request->count++ ];
+    cmd->row = cmd->col = 0;
+
+    if( strcmp( argv[ idx ], "move" ) == 0 ) {
+      int r, c;
+      char extra;
+      if( idx + 2 >= argc || sscanf( argv[ idx + 1 ], "%d%c", &r, &extra ) != 1 ||
+          sscanf( argv[ idx + 2 ], "%d%c", &c, &extra ) != 1 ) {
+        usage();
+      }
+
+      // anything off the board is sent as an out of range cell so the server reports the error
+      cmd->op = OP_MOVE;
+      cmd->row = r >= 0 && r < GRID_SIZE ? r : GRID_SIZE;
+      cmd->col = c >= 0 && c < GRID_SIZE ? c : GRID_SIZE;
+      idx += 3;
+    }
+
+    else if( strcmp( argv[ idx ], "undo" ) == 0 ) {
+      cmd->op = OP_UNDO;
+      idx++;
+    }
+
+    else if( strcmp( argv[ idx ], "report" ) == 0 ) {
+      cmd->op = OP_REPORT;
+      idx++;
+    }
+
+    else {
+      usage();
+    }
+  }
+
+  if( request->count == 0 ) {
+    usage();
+  }
+}
+
 /**
   * This program is responsible for operating on a game board for lights out game to determine if each move or specified
-  * action is valid by communicating with server.c through messsage queues.
+  * action is valid by communicating with server.c through messsage queues. All the commands given on the command line
+  * go to the server in a single request, through message queues or, with --transport=shm, shared memory rings.
   * @param argc the number of command line arguments
   * @param argv a char array of char pointers to each command line argument
   * @return program exit status
 */
 int main( int argc, char *argv[] )
 {
-    return 0;
-}
\ No newline at end of file
+  int transport = TRANSPORT_MQ;
+  int idx = 1;
+  if( argc > 1 && strncmp( argv[ 1 ], "--", 2 ) == 0 ) {
+    if( !parseTransport( argv[ 1 ], &transport ) ) {
+      usage();
+    }
+    idx++;
+  }
+
+  Request request;
+  parseCommands( argc, argv, idx, &request );
+
+  Channel chan;
+  if( !openChannel( &chan, transport ) )
+    fail( "Can't connect to the server" );
+
+  Response response;
+  if( !transact( &chan, &request, &response ) ) {
+    closeChannel( &chan );
+    fail( "Bad response from the server" );
+  }
+
+  // print the result of each command in order
+  bool ok = true;
+  for( int i = 0; i < request.count; i++ ) {
+    uint32_t result = response.result[ i ];
+    if( result == RESULT_ERROR ) {
+      printf( "error\n" );
+      ok = false;
+    }
+
+    else if( request.cmd[ i ].op == OP_REPORT ) {
+      for( int r = 0; r < GRID_SIZE; r++ ) {
+        for( int c = 0; c < GRID_SIZE; c++ ) {
+          printf( "%c", result & ( 1u << ( r * GRID_SIZE + c ) ) ? '*' : '.' );
+        }
+        printf( "\n" );
+      }
+    }
+
+    else {
+      printf( "success\n" );
+    }
+  }
+
+  closeChannel( &chan );
+  return ok ? 0 : 1;
+}
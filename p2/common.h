@@ -1,12 +1,91 @@
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <stdint.h>
+#include <stddef.h>
+
 // Name for the queue of messages going to the server.
 #define SERVER_QUEUE "/jmpatte8-server-queue"
 
-// Name for the queue of messages going to the current client.
-#define CLIENT_QUEUE "/jmpatte8-client-queue"
+// Start of the name for the queue of responses going to a client, the
+// client's pid is added to the end so every client gets its own queue.
+#define CLIENT_QUEUE_PREFIX "/jmpatte8-client-"
+
+// Room for a client queue name, the prefix plus any pid.
+#define CLIENT_QUEUE_NAME 40
+
+// Most clients the server will keep track of at once.
+#define CLIENT_LIMIT 256
 
 // Maximum length for a message in the queue
 // (Long enough to hold any server request or response)
 #define MESSAGE_LIMIT 1024
 
+// Number of messages each queue can hold before mq_send blocks.
+// (10 is the most an unprivileged user gets by default on Linux)
+#define QUEUE_DEPTH 10
+
 // Height and width of the playing area.
 #define GRID_SIZE 5
+
+// Most commands a client can put in one request.
+#define BATCH_LIMIT 64
+
+// Kinds of request. A client registers before sending commands so the
+// server opens its response queue, and unregisters when it is done. A client
+// using shared memory registers with KIND_REGISTER_SHM instead, and after that
+// its requests and responses go through its rings rather than the queues.
+#define KIND_REGISTER 1
+#define KIND_COMMANDS 2
+#define KIND_UNREGISTER 3
+#define KIND_REGISTER_SHM 4
+
+// Operation codes for a command.
+#define OP_MOVE 1
+#define OP_UNDO 2
+#define OP_REPORT 3
+
+// Result of a command that failed. A successful move or undo gets 0, and a
+// successful report gets the board, which always fits in the low 25 bits.
+#define RESULT_ERROR 0xffffffffu
+
+// One command in a request.
+typedef struct {
+  // OP_MOVE, OP_UNDO or OP_REPORT
+  uint8_t op;
+  // row and column for a move
+  uint8_t row;
+  uint8_t col;
+} Command;
+
+// A request from a client, only the first count commands are sent.
+typedef struct {
+  // pid of the client, names the queue the response goes to
+  int32_t pid;
+  // number the client gave this request, echoed in the response so it can tell which request a response answers
+  uint32_t seq;
+  // KIND_REGISTER, KIND_COMMANDS or KIND_UNREGISTER
+  uint8_t kind;
+  // number of commands in the request
+  uint16_t count;
+  // the commands, run in order
+  Command cmd[ BATCH_LIMIT ];
+} Request;
+
+// The server's response, one result per command in the request.
+typedef struct {
+  // seq of the request this answers, 0 for a registration
+  uint32_t seq;
+  // number of results
+  uint16_t count;
+  // result of each command, a board has the light at row r, column c in bit r * GRID_SIZE + c
+  uint32_t result[ BATCH_LIMIT ];
+} Response;
+
+// Number of bytes to send for a request holding the given number of commands.
+#define REQUEST_SIZE( count ) ( offsetof( Request, cmd ) + ( count ) * sizeof( Command ) )
+
+// Number of bytes to send for a response holding the given number of results.
+#define RESPONSE_SIZE( count ) ( offsetof( Response, result ) + ( count ) * sizeof( uint32_t ) )
+
+#endif
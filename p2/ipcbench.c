@@ -0,0 +1,409 @@
+/**
+  * @file ipcbench.c
+  * @author Jake Donovan (jmpatte8)
+  * Benchmark comparing the ways our programs talk to each other: pipes like maxsum, POSIX message queues like the
+  * lights out server, System V shared memory like lightsout (with the futex ring from ring.c to pass messages through
+  * it) and TCP over loopback like the scrabble server. For each one and several message sizes, a parent and child
+  * process play ping-pong to time round trips, reporting p50, p99 and p999 latency, and then the parent streams
+  * messages one way as fast as it can to measure throughput. Compile with ring.c.
+*/
+
+#include "ring.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <mqueue.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/wait.h>
+
+// Number of ping-pong round trips per test when we aren't told otherwise.
+#define DEFAULT_ROUNDS 20000
+
+// Number of messages per streaming test when we aren't told otherwise.
+#define DEFAULT_STREAM 100000
+
+// Message sizes to test, all small enough for a message queue or ring slot.
+static int const sizes[] = { 8, 64, 256, 1024 };
+#define SIZE_COUNT ( sizeof( sizes ) / sizeof( sizes[ 0 ] ) )
+
+// Kinds of link, one per transport except that pipes and TCP are both just a pair of descriptors.
+#define LINK_FD 0
+#define LINK_MQ 1
+#define LINK_RING 2
+
+// Number of transports we test.
+#define TRANSPORTS 4
+
+// Names of the transports, in the order we test them.
+static char const *const transportName[ TRANSPORTS ] = { "pipe", "mqueue", "sysv shm", "tcp" };
+
+// One process's end of a two way connection.
+typedef struct {
+  // LINK_FD, LINK_MQ or LINK_RING
+  int kind;
+  // descriptors to read and write, for LINK_FD
+  int readFd, writeFd;
+  // queues to read and write, for LINK_MQ
+  mqd_t readQueue, writeQueue;
+  // rings to read and write, for LINK_RING, and the segment holding them
+  Ring *in, *out;
+  RingPair *rings;
+} Link;
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+  fprintf( stderr, "%s\n", message );
+  exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+  fprintf( stderr, "usage: ipcbench [<round-trips> [<stream-messages>]]\n" );
+  exit( 1 );
+}
+
+/**
+  * Current time in nanoseconds.
+  * @return monotonic clock reading
+*/
+static long long nanoTime() {
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/** Comparison function for sorting latencies. */
+static int compareTimes( void const *a, void const *b ) {
+  long long x = *( long long const * )a;
+  long long y = *( long long const * )b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+  * Send one message over a link.
+  * @param link our end of the link
+  * @param buffer the message
+  * @param len number of bytes in the message
+*/
+static void linkSend( Link *link, char const *buffer, int len ) {
+  if( link->kind == LINK_MQ ) {
+    if( mq_send( link->writeQueue, buffer, len, 0 ) == -1 ) {
+      fail( "Can't send to message queue" );
+    }
+  }
+
+  else if( link->kind == LINK_RING ) {
+    ringSend( link->out, buffer, len, -1 );
+  }
+
+  else {
+    // a pipe or socket can take part of a message, keep going until it's all written
+    for( int done = 0; done < len; ) {
+      int n = write( link->writeFd, buffer + done, len - done );
+      if( n <= 0 ) {
+        fail( "Can't write to descriptor" );
+      }
+      done += n;
+    }
+  }
+}
+
+/**
+  * Receive one message from a link.
+  * @param link our end of the link
+  * @param buffer where to store the message, at least MESSAGE_LIMIT bytes
+  * @param len number of bytes in the message
+*/
+static void linkReceive( Link *link, char *buffer, int len ) {
+  if( link->kind == LINK_MQ ) {
+    if( mq_receive( link->readQueue, buffer, MESSAGE_LIMIT, NULL ) != len ) {
+      fail( "Can't receive from message queue" );
+    }
+  }
+
+  else if( link->kind == LINK_RING ) {
+    ringReceive( link->in, buffer, -1 );
+  }
+
+  else {
+    // a stream has no message boundaries, so read until we have all of it
+    for( int done = 0; done < len; ) {
+      int n = read( link->readFd, buffer + done, len - done );
+      if( n <= 0 ) {
+        fail( "Can't read from descriptor" );
+      }
+      done += n;
+    }
+  }
+}
+
+/**
+  * Make a connected pair of TCP sockets over loopback.
+  * @param fd where to store the two sockets
+*/
+static void makeSockets( int fd[ 2 ] ) {
+  int listener = socket( AF_INET, SOCK_STREAM, 0 );
+  struct sockaddr_in addr;
+  memset( &addr, 0, sizeof( addr ) );
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+  addr.sin_port = 0;
+  socklen_t addrLen = sizeof( addr );
+
+  // let the system pick a free port, then connect to whatever it picked
+  if( listener == -1 || bind( listener, ( struct sockaddr * ) &addr, sizeof( addr ) ) != 0 ||
+      listen( listener, 1 ) != 0 || getsockname( listener, ( struct sockaddr * ) &addr, &addrLen ) != 0 ) {
+    fail( "Can't create listening socket" );
+  }
+
+  fd[ 0 ] = socket( AF_INET, SOCK_STREAM, 0 );
+  if( fd[ 0 ] == -1 || connect( fd[ 0 ], ( struct sockaddr * ) &addr, sizeof( addr ) ) != 0 ) {
+    fail( "Can't connect to listening socket" );
+  }
+
+  fd[ 1 ] = accept( listener, NULL, NULL );
+  if( fd[ 1 ] == -1 ) {
+    fail( "Can't accept connection" );
+  }
+  close( listener );
+
+  // small messages should go out right away, not wait to be combined
+  int on = 1;
+  setsockopt( fd[ 0 ], IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+  setsockopt( fd[ 1 ], IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+}
+
+/**
+  * Set up a transport, filling in the parent's and child's ends of it. Everything is made before the fork
+  * so both processes inherit it.
+  * @param transport index into transportName
+  * @param parent the parent's end
+  * @param child the child's end
+*/
+static void openLinks( int transport, Link *parent, Link *child ) {
+  memset( parent, 0, sizeof( Link ) );
+  memset( child, 0, sizeof( Link ) );
+
+  if( transport == 0 ) {
+    int down[ 2 ], up[ 2 ];
+    if( pipe( down ) != 0 || pipe( up ) != 0 ) {
+      fail( "Can't create pipe" );
+    }
+
+    parent->kind = child->kind = LINK_FD;
+    parent->writeFd = down[ 1 ];
+    parent->readFd = up[ 0 ];
+    child->readFd = down[ 0 ];
+    child->writeFd = up[ 1 ];
+  }
+
+  else if( transport == 1 ) {
+    struct mq_attr attr;
+    attr.mq_flags = 0;
+    attr.mq_maxmsg = QUEUE_DEPTH;
+    attr.mq_msgsize = MESSAGE_LIMIT;
+
+    // the names are only needed to open the queues, so remove them right away
+    char down[ CLIENT_QUEUE_NAME ], up[ CLIENT_QUEUE_NAME ];
+    snprintf( down, sizeof( down ), "/jmpatte8-bench-%d-d", getpid() );
+    snprintf( up, sizeof( up ), "/jmpatte8-bench-%d-u", getpid() );
+    mqd_t downQueue = mq_open( down, O_RDWR | O_CREAT | O_EXCL, 0600, &attr );
+    mqd_t upQueue = mq_open( up, O_RDWR | O_CREAT | O_EXCL, 0600, &attr );
+    mq_unlink( down );
+    mq_unlink( up );
+    if( downQueue == -1 || upQueue == -1 ) {
+      fail( "Can't create message queues" );
+    }
+
+    parent->kind = child->kind = LINK_MQ;
+    parent->writeQueue = child->readQueue = downQueue;
+    parent->readQueue = child->writeQueue = upQueue;
+  }
+
+  else if( transport == 2 ) {
+    int shmId = shmget( IPC_PRIVATE, sizeof( RingPair ), 0600 | IPC_CREAT );
+    if( shmId == -1 ) {
+      fail( "Can't create shared memory" );
+    }
+
+    // the child inherits our attachment, and marking it removed now means it goes away when we both exit
+    RingPair *rings = ( RingPair * ) shmat( shmId, NULL, 0 );
+    shmctl( shmId, IPC_RMID, NULL );
+    if( rings == ( RingPair * ) -1 ) {
+      fail( "Can't map shared memory" );
+    }
+
+    initRing( &rings->request );
+    initRing( &rings->response );
+    parent->kind = child->kind = LINK_RING;
+    parent->rings = child->rings = rings;
+    parent->out = child->in = &rings->request;
+    parent->in = child->out = &rings->response;
+  }
+
+  else {
+    int fd[ 2 ];
+    makeSockets( fd );
+    parent->kind = child->kind = LINK_FD;
+    parent->readFd = parent->writeFd = fd[ 0 ];
+    child->readFd = child->writeFd = fd[ 1 ];
+  }
+}
+
+/**
+  * Let go of one end of a transport.
+  * @param link our end
+  * @param other the other process's end, which we also inherited
+*/
+static void closeLinks( Link *link, Link *other ) {
+  if( link->kind == LINK_MQ ) {
+    mq_close( link->readQueue );
+    mq_close( link->writeQueue );
+  }
+
+  else if( link->kind == LINK_RING ) {
+    shmdt( link->rings );
+  }
+
+  else {
+    Link *list[] = { link, other };
+    for( int i = 0; i < 2; i++ ) {
+      close( list[ i ]->readFd );
+      if( list[ i ]->writeFd != list[ i ]->readFd ) {
+        close( list[ i ]->writeFd );
+      }
+    }
+  }
+}
+
+/**
+  * Start the child process that answers the parent, closing the parent's descriptors in it so a pipe sees
+  * end of file when it should.
+  * @param parent the parent's end
+  * @param child the child's end
+  * @param size bytes per message
+  * @param rounds round trips to echo
+  * @param stream messages to take in the streaming test
+  * @return pid of the child
+*/
+static pid_t startChild( Link *parent, Link *child, int size, int rounds, int stream ) {
+  // don't let the child inherit anything we haven't printed yet
+  fflush( stdout );
+  pid_t id = fork();
+  if( id == -1 ) {
+    fail( "Can't create child process" );
+  }
+
+  if( id == 0 ) {
+    if( child->kind == LINK_FD ) {
+      close( parent->readFd );
+      if( parent->writeFd != parent->readFd ) {
+        close( parent->writeFd );
+      }
+    }
+
+    char buffer[ MESSAGE_LIMIT ];
+    for( int i = 0; i < rounds; i++ ) {
+      linkReceive( child, buffer, size );
+      linkSend( child, buffer, size );
+    }
+
+    // take the whole stream, then say we're done with a one byte message
+    for( int i = 0; i < stream; i++ ) {
+      linkReceive( child, buffer, size );
+    }
+    linkSend( child, buffer, 1 );
+    exit( 0 );
+  }
+
+  return id;
+}
+
+/**
+  * Run ping-pong and then streaming for one transport and message size, printing a line of results.
+  * @param transport index into transportName
+  * @param size bytes per message
+  * @param rounds round trips to time
+  * @param stream messages to stream
+  * @param times room for a latency per round trip
+*/
+static void runTest( int transport, int size, int rounds, int stream, long long *times ) {
+  Link parent, child;
+  openLinks( transport, &parent, &child );
+  pid_t id = startChild( &parent, &child, size, rounds, stream );
+
+  char buffer[ MESSAGE_LIMIT ];
+  memset( buffer, 'x', sizeof( buffer ) );
+
+  long long start = nanoTime();
+  for( int i = 0; i < rounds; i++ ) {
+    long long sent = nanoTime();
+    linkSend( &parent, buffer, size );
+    linkReceive( &parent, buffer, size );
+    times[ i ] = nanoTime() - sent;
+  }
+  double pingSeconds = ( nanoTime() - start ) / 1e9;
+
+  start = nanoTime();
+  for( int i = 0; i < stream; i++ ) {
+    linkSend( &parent, buffer, size );
+  }
+  linkReceive( &parent, buffer, 1 );
+  double streamSeconds = ( nanoTime() - start ) / 1e9;
+
+  int status;
+  waitpid( id, &status, 0 );
+  if( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 ) {
+    fail( "Child process failed" );
+  }
+  closeLinks( &parent, &child );
+
+  qsort( times, rounds, sizeof( long long ), compareTimes );
+  printf( "%-9s %6d %9.2f %9.2f %9.2f %11.0f %12.0f %10.1f\n", transportName[ transport ], size,
+          times[ rounds / 2 ] / 1e3, times[ ( int )( rounds * 0.99 ) ] / 1e3,
+          times[ ( int )( rounds * 0.999 ) ] / 1e3, rounds / pingSeconds, stream / streamSeconds,
+          ( double ) stream * size / streamSeconds / 1e6 );
+}
+
+/**
+  * Program starting point. Runs every transport at every message size.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+  int rounds = DEFAULT_ROUNDS;
+  int stream = DEFAULT_STREAM;
+  if( argc > 3 || ( argc > 1 && ( sscanf( argv[ 1 ], "%d", &rounds ) != 1 || rounds < 1 ) ) ||
+      ( argc > 2 && ( sscanf( argv[ 2 ], "%d", &stream ) != 1 || stream < 1 ) ) ) {
+    usage();
+  }
+
+  long long *times = ( long long * )malloc( rounds * sizeof( long long ) );
+  if( !times ) {
+    fail( "Out of memory" );
+  }
+
+  printf( "round trips: %d  streamed messages: %d\n", rounds, stream );
+  printf( "%-9s %6s %9s %9s %9s %11s %12s %10s\n", "transport", "bytes", "p50 us", "p99 us", "p999 us",
+          "trips/s", "stream msg/s", "stream MB/s" );
+
+  for( int t = 0; t < TRANSPORTS; t++ ) {
+    for( size_t s = 0; s < SIZE_COUNT; s++ ) {
+      runTest( t, sizes[ s ], rounds, stream, times );
+    }
+  }
+
+  free( times );
+  return 0;
+}
@@ -0,0 +1,255 @@
+/**
+  * @file mqbench.c
+  * @author Jake Donovan (jmpatte8)
+  * Client side benchmark for the lights out server. In batch mode one client sends requests holding 1 up to
+  * BATCH_LIMIT commands, waiting for the response to each, and we report round trips and commands per second for
+  * each batch size. In clients mode 1 up to 64 client processes do the same thing at once with a fixed batch size,
+  * showing how the server's throughput scales with the number of clients. Start the server first, every client
+  * makes an even number of moves so the board ends up unchanged. Run it once with --transport=mq and once with
+  * --transport=shm to compare message queues against shared memory rings. Compile with channel.c and ring.c.
+*/
+
+#include "channel.h"
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// Number of round trips per client when we aren't told otherwise.
+#define DEFAULT_ROUNDS 20000
+
+// Most clients we run at once in clients mode.
+#define MAX_CLIENTS 64
+
+// How every client talks to the server, TRANSPORT_MQ or TRANSPORT_SHM.
+static int transport = TRANSPORT_MQ;
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+  fprintf( stderr, "%s\n", message );
+  exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+  fprintf( stderr, "usage: mqbench [--transport=shm|mq] batch [<rounds>]\n" );
+  fprintf( stderr, "       mqbench [--transport=shm|mq] clients [<rounds> [<batch>]]\n" );
+  exit( 1 );
+}
+
+/**
+  * Seconds elapsed since the given time.
+  * @param start the starting time
+  * @return elapsed seconds
+*/
+static double elapsed( struct timespec *start ) {
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return ( now.tv_sec - start->tv_sec ) + ( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
+
+/**
+  * Number of round trips to make so the total number of moves is even.
+  * @param rounds number of round trips asked for
+  * @param batch commands per request
+  * @return rounds, or one more if that would leave an odd number of moves
+*/
+static int evenRounds( int rounds, int batch ) {
+  return batch % 2 == 0 || rounds % 2 == 0 ? rounds : rounds + 1;
+}
+
+/**
+  * Make a request of the same move over and over.
+  * @param request the request to fill in
+  * @param batch number of commands
+*/
+static void makeRequest( Request *request, int batch ) {
+  request->count = batch;
+  for( int i = 0; i < batch; i++ ) {
+    request->cmd[ i ].op = OP_MOVE;
+    request->cmd[ i ].row = 2;
+    request->cmd[ i ].col = 2;
+  }
+}
+
+/**
+  * Make the given number of round trips.
+  * @param chan an open channel
+  * @param request the request to send each time
+  * @param rounds number of round trips
+*/
+static void runRounds( Channel *chan, Request *request, int rounds ) {
+  Response response;
+  for( int i = 0; i < rounds; i++ ) {
+    if( !transact( chan, request, &response ) ) {
+      fail( "Lost contact with the server" );
+    }
+  }
+}
+
+/**
+  * One client sending each batch size in turn.
+  * @param rounds round trips per batch size
+*/
+static void batchMode( int rounds ) {
+  Channel chan;
+  if( !openChannel( &chan, transport ) ) {
+    fail( "Can't connect to the server, is it running?" );
+  }
+
+  Request request;
+  printf( "transport: %s\n", transport == TRANSPORT_SHM ? "shm" : "mq" );
+  printf( "%6s %14s %14s %12s\n", "batch", "round trips/s", "commands/s", "us/trip" );
+
+  for( int batch = 1; batch <= BATCH_LIMIT; batch *= 2 ) {
+    makeRequest( &request, batch );
+    int total = evenRounds( rounds, batch );
+
+    struct timespec start;
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    runRounds( &chan, &request, total );
+    double seconds = elapsed( &start );
+
+    printf( "%6d %14.0f %14.0f %12.2f\n", batch, total / seconds, ( double ) total * batch / seconds,
+            seconds * 1e6 / total );
+  }
+
+  closeChannel( &chan );
+}
+
+/**
+  * Run the given number of client processes at once and time them from when they're all connected
+  * until the last one finishes.
+  * @param clients number of client processes
+  * @param rounds round trips per client
+  * @param batch commands per request
+  * @return elapsed seconds
+*/
+static double runClients( int clients, int rounds, int batch ) {
+  // each client says it's ready on one pipe and waits for the other to close before starting
+  int ready[ 2 ], go[ 2 ];
+  if( pipe( ready ) != 0 || pipe( go ) != 0 ) {
+    fail( "Can't create pipe" );
+  }
+
+  // don't let the children inherit anything we haven't printed yet
+  fflush( stdout );
+  for( int i = 0; i < clients; i++ ) {
+    pid_t id = fork();
+    if( id == -1 ) {
+      fail( "Can't create client process" );
+    }
+
+    if( id == 0 ) {
+      close( ready[ 0 ] );
+      close( go[ 1 ] );
+
+      Channel chan;
+      char ok = openChannel( &chan, transport );
+      write( ready[ 1 ], &ok, 1 );
+      if( !ok ) {
+        exit( 1 );
+      }
+
+      char ch;
+      read( go[ 0 ], &ch, 1 );
+
+      Request request;
+      makeRequest( &request, batch );
+      runRounds( &chan, &request, rounds );
+      closeChannel( &chan );
+      exit( 0 );
+    }
+  }
+
+  close( ready[ 1 ] );
+  close( go[ 0 ] );
+  for( int i = 0; i < clients; i++ ) {
+    char ok;
+    if( read( ready[ 0 ], &ok, 1 ) != 1 || !ok ) {
+      fail( "A client couldn't connect to the server, is it running?" );
+    }
+  }
+
+  struct timespec start;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  close( go[ 1 ] );
+
+  bool ok = true;
+  for( int i = 0; i < clients; i++ ) {
+    int status;
+    wait( &status );
+    ok &= WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+  }
+  double seconds = elapsed( &start );
+
+  close( ready[ 0 ] );
+  if( !ok ) {
+    fail( "A client failed" );
+  }
+
+  return seconds;
+}
+
+/**
+  * Each number of clients in turn, all sending the same batch size.
+  * @param rounds round trips per client
+  * @param batch commands per request
+*/
+static void clientsMode( int rounds, int batch ) {
+  int total = evenRounds( rounds, batch );
+  printf( "transport: %s  batch: %d  round trips per client: %d\n", transport == TRANSPORT_SHM ? "shm" : "mq",
+          batch, total );
+  printf( "%7s %14s %14s %12s\n", "clients", "round trips/s", "commands/s", "us/trip" );
+
+  for( int clients = 1; clients <= MAX_CLIENTS; clients *= 2 ) {
+    double seconds = runClients( clients, total, batch );
+    double trips = ( double ) clients * total;
+    printf( "%7d %14.0f %14.0f %12.2f\n", clients, trips / seconds, trips * batch / seconds,
+            seconds * 1e6 * clients / trips );
+  }
+}
+
+/**
+  * Program starting point. Runs the benchmark in the mode given on the command line.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+  // the transport option comes first, then the rest is read as if it weren't there
+  if( argc > 1 && strncmp( argv[ 1 ], "--", 2 ) == 0 ) {
+    if( !parseTransport( argv[ 1 ], &transport ) ) {
+      usage();
+    }
+    argv[ 1 ] = argv[ 0 ];
+    argv++;
+    argc--;
+  }
+
+  int rounds = DEFAULT_ROUNDS;
+  int batch = 1;
+  if( argc < 2 || argc > 4 ||
+      ( argc > 2 && ( sscanf( argv[ 2 ], "%d", &rounds ) != 1 || rounds < 1 ) ) ||
+      ( argc > 3 && ( sscanf( argv[ 3 ], "%d", &batch ) != 1 || batch < 1 || batch > BATCH_LIMIT ) ) ) {
+    usage();
+  }
+
+  if( strcmp( argv[ 1 ], "batch" ) == 0 && argc <= 3 ) {
+    batchMode( rounds );
+  }
+
+  else if( strcmp( argv[ 1 ], "clients" ) == 0 ) {
+    clientsMode( rounds, batch );
+  }
+
+  else {
+    usage();
+  }
+
+  return 0;
+}
@@ -0,0 +1,121 @@
+/**
+  * @file ring.c
+  * @author Jake Donovan (jmpatte8)
+  * This file is responsible for the shared memory message ring. Sending and receiving are just a copy and an atomic
+  * store when the ring has room (or messages), and we only make a system call, a futex wait or wake, when one side
+  * actually has to sleep.
+*/
+
+#include "ring.h"
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Number of times to check the ring again before going to sleep on the futex.
+#define SPIN_LIMIT 100
+
+/**
+  * Sleep until the value at addr is no longer expected, or we're woken, or we run out of time.
+  * The futex is shared between processes, so this can't use the private futex operations.
+  * @param addr the futex word
+  * @param expected value we saw, we don't sleep if it has already changed
+  * @param timeout most milliseconds to sleep, or -1 for no limit
+*/
+static void futexWait( _Atomic uint32_t *addr, uint32_t expected, int timeout ) {
+  struct timespec limit;
+  limit.tv_sec = timeout / 1000;
+  limit.tv_nsec = ( timeout % 1000 ) * 1000000L;
+  syscall( SYS_futex, ( uint32_t * ) addr, FUTEX_WAIT, expected, timeout < 0 ? NULL : &limit, NULL, 0 );
+}
+
+/**
+  * Wake the one thread that could be sleeping on the given futex.
+  * @param addr the futex word
+*/
+static void futexWake( _Atomic uint32_t *addr ) {
+  syscall( SYS_futex, ( uint32_t * ) addr, FUTEX_WAKE, 1, NULL, NULL, 0 );
+}
+
+/**
+  * Wait for the counter at addr to move past the value we saw.
+  * @param addr counter the other side changes
+  * @param seen value we saw
+  * @param waiting our waiting flag, so the other side knows to wake us
+  * @param timeout most milliseconds to sleep, or -1 for no limit
+  * @return true if it changed, false if we ran out of time
+*/
+static bool waitForChange( _Atomic uint32_t *addr, uint32_t seen, _Atomic uint32_t *waiting, int timeout ) {
+  // the other side is usually only a moment behind, so look a few more times before paying for a sleep
+  for( int i = 0; i < SPIN_LIMIT; i++ ) {
+    if( atomic_load_explicit( addr, memory_order_acquire ) != seen ) {
+      return true;
+    }
+  }
+
+  // set the flag before looking one last time, so the other side either sees the flag or we see its change
+  atomic_store( waiting, 1 );
+  if( atomic_load( addr ) == seen ) {
+    futexWait( addr, seen, timeout );
+  }
+  atomic_store( waiting, 0 );
+
+  return atomic_load_explicit( addr, memory_order_acquire ) != seen;
+}
+
+void initRing( Ring *ring ) {
+  atomic_init( &ring->head, 0 );
+  atomic_init( &ring->tail, 0 );
+  atomic_init( &ring->readerWaiting, 0 );
+  atomic_init( &ring->writerWaiting, 0 );
+}
+
+bool ringSend( Ring *ring, void const *msg, int len, int timeout ) {
+  uint32_t head = atomic_load_explicit( &ring->head, memory_order_relaxed );
+
+  // full, wait for the reader to take something
+  uint32_t tail;
+  while( head - ( tail = atomic_load_explicit( &ring->tail, memory_order_acquire ) ) == RING_SLOTS ) {
+    if( !waitForChange( &ring->tail, tail, &ring->writerWaiting, timeout ) && timeout >= 0 ) {
+      return false;
+    }
+  }
+
+  RingSlot *slot = &ring->slot[ head % RING_SLOTS ];
+  slot->len = len;
+  memcpy( slot->data, msg, len );
+
+  // publish the message, then wake the reader only if it went to sleep
+  atomic_store( &ring->head, head + 1 );
+  if( atomic_load( &ring->readerWaiting ) ) {
+    futexWake( &ring->head );
+  }
+
+  return true;
+}
+
+int ringReceive( Ring *ring, void *buffer, int timeout ) {
+  uint32_t tail = atomic_load_explicit( &ring->tail, memory_order_relaxed );
+
+  // empty, wait for the writer to add something
+  while( atomic_load_explicit( &ring->head, memory_order_acquire ) == tail ) {
+    if( !waitForChange( &ring->head, tail, &ring->readerWaiting, timeout ) && timeout >= 0 ) {
+      return -1;
+    }
+  }
+
+  // the other side could be any process that can open the ring, so never copy more than a slot holds
+  RingSlot *slot = &ring->slot[ tail % RING_SLOTS ];
+  int len = slot->len < MESSAGE_LIMIT ? slot->len : MESSAGE_LIMIT;
+  memcpy( buffer, slot->data, len );
+
+  // give the slot back, then wake the writer only if it went to sleep
+  atomic_store( &ring->tail, tail + 1 );
+  if( atomic_load( &ring->writerWaiting ) ) {
+    futexWake( &ring->tail );
+  }
+
+  return len;
+}
@@ -0,0 +1,82 @@
+/**
+  * @file ring.h
+  * @author Jake Donovan (jmpatte8)
+  * Header for the single-producer, single-consumer message ring that lets a client on the same machine talk to the
+  * server through shared memory instead of message queues.
+*/
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "common.h"
+
+// Start of the name for a client's shared memory rings, the client's pid is added to the end.
+#define RING_PREFIX "/jmpatte8-ring-"
+
+// Number of messages a ring can hold, must be a power of two.
+#define RING_SLOTS 16
+
+// One message in a ring.
+typedef struct {
+  // number of bytes of data in use
+  uint32_t len;
+  // the message
+  char data[ MESSAGE_LIMIT ];
+} RingSlot;
+
+// A ring of messages with one writer and one reader. head and tail only ever count up, and each is on its own
+// cache line so the writer and reader don't fight over the same line. A side that finds the ring empty (or full)
+// sets its waiting flag and sleeps on a futex, and the other side only makes the wake up call if that flag is set.
+typedef struct {
+  // number of messages ever written, only the writer changes it
+  _Atomic uint32_t head;
+  char pad1[ 64 - sizeof( uint32_t ) ];
+  // number of messages ever read, only the reader changes it
+  _Atomic uint32_t tail;
+  char pad2[ 64 - sizeof( uint32_t ) ];
+  // true while the reader is asleep waiting for head to change
+  _Atomic uint32_t readerWaiting;
+  // true while the writer is asleep waiting for tail to change
+  _Atomic uint32_t writerWaiting;
+  char pad3[ 64 - 2 * sizeof( uint32_t ) ];
+  // the messages
+  RingSlot slot[ RING_SLOTS ];
+} Ring;
+
+// Everything a client shares with the server, one ring each way.
+typedef struct {
+  // requests from the client to the server
+  Ring request;
+  // responses from the server to the client
+  Ring response;
+} RingPair;
+
+/**
+  * Initialize an empty ring.
+  * @param ring the ring
+*/
+void initRing( Ring *ring );
+
+/**
+  * Add a message to the ring, waiting if it is full. Only one thread may ever send on a ring.
+  * @param ring the ring
+  * @param msg the message
+  * @param len number of bytes in the message, at most MESSAGE_LIMIT
+  * @param timeout most milliseconds to wait for room, or -1 to wait as long as it takes
+  * @return true if the message was added, false if we ran out of time
+*/
+bool ringSend( Ring *ring, void const *msg, int len, int timeout );
+
+/**
+  * Take the next message from the ring, waiting if it is empty. Only one thread may ever receive on a ring.
+  * @param ring the ring
+  * @param buffer where to store the message, at least MESSAGE_LIMIT bytes
+  * @param timeout most milliseconds to wait for a message, or -1 to wait as long as it takes
+  * @return number of bytes in the message, or -1 if we ran out of time
+*/
+int ringReceive( Ring *ring, void *buffer, int timeout );
+
+#endif
@@ -2,10 +2,15 @@
   * @file server.c
   * @author Jake Donovan (jmpatte8)
   * This file is responsible for reprompting client for messages until we receive a SIGNAL to close the server
-  * this file will use two message queues for receiving messages from the client and sending responses back to the client
+  * this file will use a message queue for receiving messages from clients and one queue per client, named after its pid,
+  * for sending responses back to that client. Each message is a binary Request holding a batch of commands, and the
+  * server answers with one Response holding a result for every command, so a client can run many commands for a
+  * single send and receive. A client can also register a pair of shared memory rings instead of a response queue,
+  * then a thread of its own serves its rings and the board is shared between every thread under a lock.
 */
 
 #include "common.h"
+#include "ring.h"
 #include <stdlib.h>
 #include <stdbool.h>
 #include <unistd.h>
@@ -16,6 +21,11 @@
 #include <signal.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
 
 // Print out an error message and exit.
 static void fail( char const *message ) {
@@ -24,61 +34,538 @@ static void fail( char const *message ) {
 }
 
 // Flag for telling the server to stop running because of a sigint.
-// This is safer than trying to print in the signal handler.
-static int running = 1;
+// This is safer than trying to print in the signal handler. It is atomic since
+// the ring threads watch it too.
+static atomic_int running = 1;
+
+// Handler for SIGINT, just tells the main loop to stop.
+static void interruptHandler( int sig ) {
+  ( void ) sig;
+  running = 0;
+}
+
+// Current board, the light at row r, column c is bit r * GRID_SIZE + c.
+static uint32_t board;
+
+// Board from before the last move, for undo.
+static uint32_t previous;
+
+// True if there is a move that can be undone.
+static bool canUndo = false;
+
+// Lock for the board, previous and canUndo, held for a whole request so its commands run together.
+static pthread_mutex_t boardLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Milliseconds a ring thread waits for a request before checking whether we're stopping or its client died.
+#define RING_POLL 100
+
+// Milliseconds a ring thread waits for room in a response ring before it gives up on the client.
+#define RING_REPLY_TIMEOUT 1000
+
+// Milliseconds we wait for room in a full response queue before we give up on the client, the
+// main loop is held up the whole time so it is short.
+#define QUEUE_REPLY_TIMEOUT 100
+
+// Print out a message about a bad board file and exit.
+static void invalidFile( char const *fileName ) {
+  fprintf( stderr, "Invalid input file: %s\n", fileName );
+  exit( 1 );
+}
 
 /**
-  * Creates two servers for receiving messages from client and sending responses to client via message queues
+  * Read the starting board from a file of GRID_SIZE lines of '.' and '*'.
+  * @param fileName name of the board file
+*/
+static void readBoard( char const *fileName ) {
+  FILE *fp = fopen( fileName, "r" );
+  if( !fp ) {
+    invalidFile( fileName );
+  }
+
+  board = 0;
+  for( int r = 0; r < GRID_SIZE; r++ ) {
+    for( int c = 0; c < GRID_SIZE; c++ ) {
+      int ch = fgetc( fp );
+      if( ch == '*' ) {
+        board |= 1u << ( r * GRID_SIZE + c );
+      }
+
+      else if( ch != '.' ) {
+        invalidFile( fileName );
+      }
+    }
+
+    // every row ends with a newline
+    if( fgetc( fp ) != '\n' ) {
+      invalidFile( fileName );
+    }
+  }
+
+  fclose( fp );
+}
+
+/**
+  * Mask of the lights a move at the given cell toggles.
+  * @param r the row of the move
+  * @param c the column of the move
+  * @return the toggle mask
+*/
+static uint32_t moveMask( int r, int c ) {
+  uint32_t mask = 1u << ( r * GRID_SIZE + c );
+  if( r > 0 )
+    mask |= 1u << ( ( r - 1 ) * GRID_SIZE + c );
+  if( r < GRID_SIZE - 1 )
+    mask |= 1u << ( ( r + 1 ) * GRID_SIZE + c );
+  if( c > 0 )
+    mask |= 1u << ( r * GRID_SIZE + c - 1 );
+  if( c < GRID_SIZE - 1 )
+    mask |= 1u << ( r * GRID_SIZE + c + 1 );
+  return mask;
+}
+
+/**
+  * Run one command from a client against the board.
+  * @param cmd the command
+  * @return the result to send back for it
+*/
+static uint32_t runCommand( Command const *cmd ) {
+  switch( cmd->op ) {
+    case OP_MOVE:
+      if( cmd->row >= GRID_SIZE || cmd->col >= GRID_SIZE ) {
+        return RESULT_ERROR;
+      }
+
+      previous = board;
+      board ^= moveMask( cmd->row, cmd->col );
+      canUndo = true;
+      return 0;
+
+    case OP_UNDO:
+      if( !canUndo ) {
+        return RESULT_ERROR;
+      }
+
+      board = previous;
+      canUndo = false;
+      return 0;
+
+    case OP_REPORT:
+      return board;
+
+    default:
+      return RESULT_ERROR;
+  }
+}
+
+/**
+  * Print the board, one row per line.
+*/
+static void printBoard() {
+  for( int r = 0; r < GRID_SIZE; r++ ) {
+    for( int c = 0; c < GRID_SIZE; c++ ) {
+      printf( "%c", board & ( 1u << ( r * GRID_SIZE + c ) ) ? '*' : '.' );
+    }
+    printf( "\n" );
+  }
+}
+
+/**
+  * Run every command in a request against the board.
+  * @param request the request
+  * @param len number of bytes that arrived for it
+  * @param response where to store a result for each command
+  * @return number of commands run
+*/
+static int runRequest( Request *request, int len, Response *response ) {
+  // never trust the count past what actually arrived
+  int count = request->count;
+  int sent = ( len - offsetof( Request, cmd ) ) / sizeof( Command );
+  if( count > sent ) {
+    count = sent;
+  }
+
+  if( count > BATCH_LIMIT ) {
+    count = BATCH_LIMIT;
+  }
+
+  response->seq = request->seq;
+  pthread_mutex_lock( &boardLock );
+  for( int i = 0; i < count; i++ ) {
+    response->result[ i ] = runCommand( &request->cmd[ i ] );
+  }
+  pthread_mutex_unlock( &boardLock );
+
+  return count;
+}
+
+// A registered client and the queue its responses go to.
+typedef struct {
+  // pid of the client
+  int pid;
+  // the client's response queue, opened non-blocking
+  mqd_t queue;
+} Client;
+
+// Every registered client.
+static Client clients[ CLIENT_LIMIT ];
+
+// Number of registered clients.
+static int clientCount = 0;
+
+/**
+  * Find a registered client.
+  * @param pid pid of the client
+  * @return the client, or NULL if it isn't registered
+*/
+static Client *findClient( int pid ) {
+  for( int i = 0; i < clientCount; i++ ) {
+    if( clients[ i ].pid == pid ) {
+      return &clients[ i ];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  * Check whether a client's process is still running.
+  * @param pid pid of the client
+  * @return true unless there is no such process
+*/
+static bool alive( int pid ) {
+  return kill( pid, 0 ) == 0 || errno == EPERM;
+}
+
+/**
+  * Forget a client, closing its queue. The client removes the queue itself.
+  * @param client the client to remove
+*/
+static void removeClient( Client *client ) {
+  mq_close( client->queue );
+  *client = clients[ --clientCount ];
+}
+
+/**
+  * Send a response to a client. The queue is non-blocking so a client that stopped reading can't
+  * hold up everyone else. If its queue is full and the client is still running we wait a little
+  * for room, otherwise, or if there still isn't any, the client can't get its response so we
+  * forget it.
+  * @param client the client
+  * @param response the response
+  * @param count number of results in the response
+*/
+static void reply( Client *client, Response *response, int count ) {
+  response->count = count;
+  if( mq_send( client->queue, ( char * ) response, RESPONSE_SIZE( count ), 0 ) == 0 ) {
+    return;
+  }
+
+  if( errno == EAGAIN && alive( client->pid ) ) {
+    struct timespec deadline;
+    clock_gettime( CLOCK_REALTIME, &deadline );
+    deadline.tv_nsec += QUEUE_REPLY_TIMEOUT * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+
+    // mq_timedsend only waits on a blocking queue
+    struct mq_attr attr = { 0 };
+    mq_setattr( client->queue, &attr, NULL );
+    int sent = mq_timedsend( client->queue, ( char * ) response, RESPONSE_SIZE( count ), 0, &deadline );
+    attr.mq_flags = O_NONBLOCK;
+    mq_setattr( client->queue, &attr, NULL );
+    if( sent == 0 ) {
+      return;
+    }
+  }
+
+  removeClient( client );
+}
+
+/**
+  * Register a client, opening its response queue and acknowledging with an empty response.
+  * @param pid pid of the client
+*/
+static void registerClient( int pid ) {
+  char name[ CLIENT_QUEUE_NAME ];
+  snprintf( name, sizeof( name ), "%s%d", CLIENT_QUEUE_PREFIX, pid );
+  mqd_t queue = mq_open( name, O_WRONLY | O_NONBLOCK );
+  if( queue == -1 ) {
+    return;
+  }
+
+  // a new process that reused the pid of one that never unregistered
+  Client *old = findClient( pid );
+  if( old ) {
+    removeClient( old );
+  }
+
+  // clients that died without unregistering shouldn't keep a live one out
+  for( int i = clientCount - 1; clientCount == CLIENT_LIMIT && i >= 0; i-- ) {
+    if( !alive( clients[ i ].pid ) ) {
+      removeClient( &clients[ i ] );
+    }
+  }
+
+  Response response;
+  response.seq = 0;
+  if( clientCount == CLIENT_LIMIT ) {
+    // no room, tell the client with a single error and forget it
+    response.count = 1;
+    response.result[ 0 ] = RESULT_ERROR;
+    mq_send( queue, ( char * ) &response, RESPONSE_SIZE( 1 ), 0 );
+    mq_close( queue );
+    return;
+  }
+
+  Client *client = &clients[ clientCount++ ];
+  client->pid = pid;
+  client->queue = queue;
+  reply( client, &response, 0 );
+}
+
+// Number of threads serving client rings, and a condition to wait for them all to finish.
+static int ringCount = 0;
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ringDone = PTHREAD_COND_INITIALIZER;
+
+// A client that talks to us through rings, handed to the thread serving it.
+typedef struct {
+  // pid of the client
+  int pid;
+  // its rings, mapped for the thread
+  RingPair *rings;
+} RingClient;
+
+/**
+  * Start routine for the thread serving one client's rings. Answers each request until the client
+  * unregisters, stops reading its responses, dies, or we get a SIGINT.
+  * @param arg the client, which the thread frees
+*/
+static void *serveRings( void *arg ) {
+  RingClient *client = ( RingClient * ) arg;
+  int pid = client->pid;
+  RingPair *rings = client->rings;
+  free( client );
+  union {
+    Request request;
+    char raw[ MESSAGE_LIMIT ];
+  } msg;
+  Response response;
+
+  // acknowledge the registration with an empty response
+  response.seq = 0;
+  response.count = 0;
+  bool ok = ringSend( &rings->response, &response, RESPONSE_SIZE( 0 ), RING_REPLY_TIMEOUT );
+
+  while( ok && running ) {
+    int len = ringReceive( &rings->request, msg.raw, RING_POLL );
+
+    // a client that crashed never unregisters, so while it's quiet we check it's still there
+    if( len == -1 && !alive( pid ) ) {
+      break;
+    }
+
+    if( len < ( int ) offsetof( Request, cmd ) ) {
+      continue;
+    }
+
+    if( msg.request.kind == KIND_UNREGISTER ) {
+      break;
+    }
+
+    response.count = runRequest( &msg.request, len, &response );
+    ok = ringSend( &rings->response, &response, RESPONSE_SIZE( response.count ), RING_REPLY_TIMEOUT );
+  }
+
+  // the client removes the rings itself
+  munmap( rings, sizeof( RingPair ) );
+
+  pthread_mutex_lock( &ringLock );
+  ringCount--;
+  pthread_cond_signal( &ringDone );
+  pthread_mutex_unlock( &ringLock );
+  return NULL;
+}
+
+/**
+  * Register a client that talks to us through shared memory rings, starting a thread to serve them.
+  * @param pid pid of the client
+*/
+static void registerRings( int pid ) {
+  char name[ CLIENT_QUEUE_NAME ];
+  snprintf( name, sizeof( name ), "%s%d", RING_PREFIX, pid );
+  int fd = shm_open( name, O_RDWR, 0 );
+  if( fd == -1 ) {
+    return;
+  }
+
+  void *addr = mmap( NULL, sizeof( RingPair ), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  close( fd );
+  if( addr == MAP_FAILED ) {
+    return;
+  }
+
+  RingPair *rings = ( RingPair * ) addr;
+  RingClient *client = ( RingClient * ) malloc( sizeof( RingClient ) );
+  pthread_mutex_lock( &ringLock );
+  bool room = client && ringCount < CLIENT_LIMIT;
+  if( room ) {
+    ringCount++;
+  }
+  pthread_mutex_unlock( &ringLock );
+
+  // only the SIGINT to this thread should stop poll, so the ring thread starts with it blocked
+  sigset_t block, old;
+  sigemptyset( &block );
+  sigaddset( &block, SIGINT );
+  pthread_sigmask( SIG_BLOCK, &block, &old );
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init( &attr );
+  pthread_attr_setdetachstate( &attr, PTHREAD_CREATE_DETACHED );
+  if( room ) {
+    client->pid = pid;
+    client->rings = rings;
+  }
+
+  if( room && pthread_create( &thread, &attr, serveRings, client ) != 0 ) {
+    pthread_mutex_lock( &ringLock );
+    ringCount--;
+    pthread_mutex_unlock( &ringLock );
+    room = false;
+  }
+  pthread_attr_destroy( &attr );
+  pthread_sigmask( SIG_SETMASK, &old, NULL );
+
+  if( !room ) {
+    free( client );
+
+    // no room, tell the client with a single error and forget it, nobody else is writing its response ring yet
+    Response response;
+    response.seq = 0;
+    response.count = 1;
+    response.result[ 0 ] = RESULT_ERROR;
+    ringSend( &rings->response, &response, RESPONSE_SIZE( 1 ), 0 );
+    munmap( rings, sizeof( RingPair ) );
+  }
+}
+
+/**
+  * Handle one message from the server queue.
+  * @param request the message
+  * @param len number of bytes in the message
+*/
+static void handleMessage( Request *request, int len ) {
+  // too short to even hold a count
+  if( len < ( int ) offsetof( Request, cmd ) ) {
+    return;
+  }
+
+  if( request->kind == KIND_REGISTER ) {
+    registerClient( request->pid );
+    return;
+  }
+
+  if( request->kind == KIND_REGISTER_SHM ) {
+    registerRings( request->pid );
+    return;
+  }
+
+  // nobody to answer
+  Client *client = findClient( request->pid );
+  if( !client ) {
+    return;
+  }
+
+  if( request->kind == KIND_UNREGISTER ) {
+    removeClient( client );
+    return;
+  }
+
+  Response response;
+  int count = runRequest( request, len, &response );
+  reply( client, &response, count );
+}
+
+/**
+  * Creates the queue for receiving requests from clients, then runs every command in each request against the board
+  * until we get a SIGINT. Each client registers first, and gets its responses on its own queue or its own ring.
   * @param argc the number of command line arguments
   * @param argv all command line arguments as strings
   * @return program exit status
 */
 int main( int argc, char *argv[] ) {
-  // Remove both queues, in case, last time, this program terminated
+  if( argc != 2 ) {
+    fail( "usage: server <board-file>" );
+  }
+
+  readBoard( argv[ 1 ] );
+
+  // Remove the queue, in case, last time, this program terminated
   // abnormally with some queued messages still queued.
   mq_unlink( SERVER_QUEUE );
-  mq_unlink( CLIENT_QUEUE );
 
   // Prepare structure indicating maximum queue and message sizes.
   struct mq_attr attr;
   attr.mq_flags = 0;
-  attr.mq_maxmsg = 1;
+  attr.mq_maxmsg = QUEUE_DEPTH;
   attr.mq_msgsize = MESSAGE_LIMIT;
 
-  // Make both the server and client message queues.
-  mqd_t serverQueue = mq_open( SERVER_QUEUE, O_RDONLY | O_CREAT, 0600, &attr );
-  mqd_t clientQueue = mq_open( CLIENT_QUEUE, O_WRONLY | O_CREAT, 0600, &attr );
+  // Make the server queue. It is non-blocking so we can empty it each time poll says it has messages.
+  mqd_t serverQueue = mq_open( SERVER_QUEUE, O_RDONLY | O_CREAT | O_NONBLOCK, 0600, &attr );
   
-  if ( serverQueue == -1 || clientQueue == -1 )
+  if ( serverQueue == -1 )
     fail( "Can't create the needed message queues" );
 
-  char msgPtr[ MESSAGE_LIMIT ];
+  // no SA_RESTART, so a SIGINT interrupts poll and we notice running went to zero
+  struct sigaction act = { 0 };
+  act.sa_handler = interruptHandler;
+  sigemptyset( &act.sa_mask );
+  sigaction( SIGINT, &act, NULL );
+
+  // big enough for any message, including a request with extra bytes we'll ignore
+  union {
+    Request request;
+    char raw[ MESSAGE_LIMIT ];
+  } msg;
+
+  // on Linux a message queue descriptor is a file descriptor, so we can wait on it with poll
+  struct pollfd pfd;
+  pfd.fd = ( int ) serverQueue;
+  pfd.events = POLLIN;
 
   // Repeatedly read and process client messages.
   while ( running ) {
-    int len = mq_receive( serverQueue, msgPtr, sizeof( msgPtr ), NULL );
+    if( poll( &pfd, 1, -1 ) <= 0 ) {
+      continue;
+    }
 
-    if( len > 0 ){
-      printf("GOT MESSAGE!");
+    // handle everything that has arrived from every client before waiting again
+    int len;
+    while( running && ( len = mq_receive( serverQueue, msg.raw, sizeof( msg.raw ), NULL ) ) >= 0 ) {
+      handleMessage( &msg.request, len );
+    }
+  }
 
-      for( int i = 0; i < len; i++ ) {
-        printf( "%c", msgPtr[ i ] );
-      }
+  // let every ring thread notice we're stopping before the final board is printed
+  pthread_mutex_lock( &ringLock );
+  while( ringCount > 0 ) {
+    pthread_cond_wait( &ringDone, &ringLock );
+  }
+  pthread_mutex_unlock( &ringLock );
 
-      printf("\n");
-    }
+  // print the final board, like we always have when the server is stopped
+  printf( "\n" );
+  printBoard();
 
-    else {
-      //
-    }
+  // Close our queues (and delete ours), the clients remove their own.
+  while( clientCount > 0 ) {
+    removeClient( &clients[ 0 ] );
   }
 
-  // Close our two message queues (and delete them).
-  mq_close( clientQueue );
   mq_close( serverQueue );
-
   mq_unlink( SERVER_QUEUE );
-  mq_unlink( CLIENT_QUEUE );
 
   return 0;
 }
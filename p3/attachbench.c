@@ -0,0 +1,157 @@
+/**
+  * @file attachbench.c
+  * @author Jake Donovan (jmpatte8)
+  * Benchmark comparing how long it takes lightsout to get at a session with the System V segment and with a
+  * mapped state file. Each attach is timed from nothing to having read a board snapshot, which is the work
+  * every lightsout command does before it can run. Uses its own key and file so it doesn't disturb a game
+  * in the same directory. Compile with session.c.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include "common.h"
+
+// Number of attaches to time when we aren't told otherwise.
+#define DEFAULT_COUNT 10000
+
+// Number of sessions in each table.
+#define SESSIONS 1000
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+  fprintf( stderr, "%s\n", message );
+  exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+  fprintf( stderr, "usage: attachbench [<attaches> [<state-file>]]\n" );
+  exit( 1 );
+}
+
+/**
+  * Current time in nanoseconds.
+  * @return monotonic clock reading
+*/
+static long long nanoTime() {
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/** Comparison function for sorting latencies. */
+static int compareTimes( void const *a, void const *b ) {
+  long long x = *( long long const * )a;
+  long long y = *( long long const * )b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+  * Attach the table the given way, read a session and detach, count times.
+  * @param key System V key, used when path is NULL
+  * @param path state file to map, or NULL for System V
+  * @param times where to store the latency of each attach
+  * @param count number of attaches
+*/
+static void timeAttach( key_t key, char const *path, long long *times, int count ) {
+  uint64_t board[ MAX_GRID_SIZE ];
+  for( int i = 0; i < count; i++ ) {
+    long long start = nanoTime();
+    SessionTable *table = path ? attachTableFile( path ) : attachTable( key );
+    if( !table ) {
+      fail( "Can't attach the table" );
+    }
+
+    GameState *state = findSession( table, i % SESSIONS );
+    if( !state ) {
+      fail( "Session is missing" );
+    }
+
+    readBoard( state, board );
+    detachTable( table, false );
+    times[ i ] = nanoTime() - start;
+  }
+}
+
+/**
+  * Print latency percentiles for one way of attaching.
+  * @param label name of the method
+  * @param times latency of each attach, sorted by this function
+  * @param count number of attaches
+*/
+static void report( char const *label, long long *times, int count ) {
+  long long first = times[ 0 ];
+  double total = 0;
+  for( int i = 0; i < count; i++ ) {
+    total += times[ i ];
+  }
+
+  qsort( times, count, sizeof( long long ), compareTimes );
+  printf( "%-10s first %8.1f us  mean %7.2f us  p50 %7.2f us  p99 %7.2f us  max %8.1f us\n", label,
+          first / 1e3, total / count / 1e3, times[ count / 2 ] / 1e3,
+          times[ ( int )( count * 0.99 ) ] / 1e3, times[ count - 1 ] / 1e3 );
+}
+
+/**
+  * Program starting point. Makes a table each way and times attaching to it.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+  int count = DEFAULT_COUNT;
+  char const *path = "attachbench.state";
+  if( argc > 3 || ( argc > 1 && ( sscanf( argv[ 1 ], "%d", &count ) != 1 || count < 1 ) ) ) {
+    usage();
+  }
+
+  if( argc > 2 ) {
+    path = argv[ 2 ];
+  }
+
+  key_t key = ftok( ".", 2 );
+  if( key == -1 ) {
+    fail( "Key could not be created using ftok" );
+  }
+
+  uint64_t rows[ MAX_GRID_SIZE ] = { 0x15, 0x0a, 0x1f, 0x0a, 0x15 };
+
+  // set both tables up the same way, then let go of them so every timed attach starts from nothing
+  SessionTable *shm = createTable( key, SESSIONS );
+  SessionTable *file = createTableFile( path, SESSIONS );
+  if( !shm || !file ) {
+    fail( "Can't create the tables" );
+  }
+
+  for( int i = 0; i < SESSIONS; i++ ) {
+    newSession( shm, rows, 5 );
+    newSession( file, rows, 5 );
+  }
+
+  checkpointTable( file );
+  detachTable( file, false );
+  detachTable( shm, false );
+
+  long long *times = ( long long * )malloc( count * sizeof( long long ) );
+  printf( "attaches: %d  sessions: %d  table: %zu bytes\n", count, SESSIONS, tableBytes( SESSIONS ) );
+
+  timeAttach( key, NULL, times, count );
+  report( "sysv shm", times, count );
+
+  timeAttach( key, path, times, count );
+  report( "mmap file", times, count );
+
+  // clean up after ourselves
+  shm = attachTable( key );
+  if( shm ) {
+    detachTable( shm, true );
+  }
+  unlink( path );
+  free( times );
+  return 0;
+}
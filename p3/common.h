@@ -2,23 +2,338 @@
   * @file common.h
   * @author Jake Donovan (jmpatte8)
   * Header file that defines GameState struct and all necessary macros for lightsout.c and reset.c
+  * The shared segment starts with a SessionTable header describing the segment, followed by a fixed
+  * number of GameState slots, one per game session. Each slot holds the rows of the previous board and
+  * then the rows of the current board. Each row is one 64-bit word with bit c set when the light in
+  * column c is on, so a move only touches three words no matter how big the board is.
 */
 
-// Height and width of the playing area.
-#define GRID_SIZE 5
+#ifndef COMMON_H
+#define COMMON_H
 
-// Size of the shared block of memory.
-#define BLOCK_SIZE 1024
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
 
-// Define GameState struct
+// Largest height and width of the playing area, one row has to fit in a 64-bit word.
+#define MAX_GRID_SIZE 64
+
+// Marks a segment that holds lightsout sessions ("LOUT").
+#define STATE_MAGIC 0x4c4f5554
+
+// Layout version of the segment, bump this whenever SessionTable or GameState changes.
+#define STATE_VERSION 4
+
+// Room for the kernel's boot id string and its terminator.
+#define BOOT_ID_LIMIT 40
+
+// Number of session slots reset makes room for when it isn't told otherwise.
+#define DEFAULT_SESSIONS 64
+
+// Times readBoard retries without the lock before it takes the lock instead, a writer that died part way
+// through a change would otherwise keep it retrying forever.
+#define READ_RETRY_LIMIT 1000
+
+// Height and width of the boards the hint table made by explore covers.
+#define HINT_SIZE 5
+
+// Number of cells on a hint table board.
+#define HINT_CELLS ( HINT_SIZE * HINT_SIZE )
+
+// Number of boards in the hint table, one for every way the lights could be set.
+#define HINT_STATES ( 1L << HINT_CELLS )
+
+// Marks a hint table file ("LOHT").
+#define HINT_MAGIC 0x4c4f4854
+
+// File explore writes the hint table to, and lightsout looks for it in, by default.
+#define HINT_FILE "lightsout.hints"
+
+// Define HintHeader struct, the start of a hint table file. It is followed by HINT_STATES four-bit
+// entries, two per byte with the lower numbered board in the low bits. Each entry is the fewest
+// moves that solve that board, and a 0 for any board but the solved one means it can't be solved.
+struct HintHeaderStruct {
+    // HINT_MAGIC
+    uint32_t magic;
+    // HINT_SIZE of the program that made the table
+    uint32_t size;
+};
+
+/** Typedef HintHeader */
+typedef struct HintHeaderStruct HintHeader;
+
+// Define GameState struct, one of these per session slot
 struct GameStateStruct {
+    // true while this slot holds a session, only changed with both the table lock and this lock held
+    bool inUse;
+    // next slot on the free list when this one isn't in use, -1 at the end of the list
+    int nextFree;
+    // height and width of the playing area
+    int size;
+    // process-shared, robust mutex so only one lightsout process can change the board at a time
+    pthread_mutex_t lock;
+    // sequence counter for report, odd while a writer is in the middle of changing the current rows
+    atomic_uint seq;
     // need to keep track of when we perform a move command
     bool isMoved;
-    // need this for undo move
-    char previousState[ GRID_SIZE ][ GRID_SIZE ];
-    // current board
-    char currentState[ GRID_SIZE ][ GRID_SIZE ];
+    // size rows of the previous board (for undo) followed by size rows of the current board
+    uint64_t rows[ 2 * MAX_GRID_SIZE ];
 };
 
 /** Typedef GameState */
 typedef struct GameStateStruct GameState;
+
+// Define SessionTable struct, the header at the start of the segment
+struct SessionTableStruct {
+    // STATE_MAGIC once reset has finished setting up the segment
+    uint32_t magic;
+    // STATE_VERSION of the program that made the segment
+    uint32_t version;
+    // id of the shared memory segment, so any process can remove it, or -1 for a state file
+    int shmId;
+    // for a state file, the boot the locks were last used in, so we know to reset them after a reboot
+    char bootId[ BOOT_ID_LIMIT ];
+    // number of session slots following this header
+    int capacity;
+    // number of slots in use
+    int used;
+    // first free slot, -1 when every slot is in use
+    int freeHead;
+    // process-shared, robust mutex protecting the free list and used
+    pthread_mutex_t lock;
+    // the session slots, a session id is an index into this array
+    GameState slots[];
+};
+
+/** Typedef SessionTable */
+typedef struct SessionTableStruct SessionTable;
+
+/**
+  * Number of bytes needed for a segment with the given number of session slots.
+  * @param capacity number of session slots
+  * @return size of the segment in bytes
+*/
+static inline size_t tableBytes( int capacity ) {
+  return sizeof( SessionTable ) + ( size_t ) capacity * sizeof( GameState );
+}
+
+// Session table functions, defined in session.c
+
+/**
+  * Create a new segment for the given key with room for capacity sessions, replacing any old one.
+  * @return the attached table or NULL on failure
+*/
+SessionTable *createTable( key_t key, int capacity );
+
+/**
+  * Attach the existing segment for the given key and check that it holds a session table.
+  * @return the attached table or NULL on failure
+*/
+SessionTable *attachTable( key_t key );
+
+/**
+  * Create a new state file at the given path with room for capacity sessions, replacing any old one.
+  * @return the mapped table or NULL on failure
+*/
+SessionTable *createTableFile( char const *path, int capacity );
+
+/**
+  * Map an existing state file. Nothing is parsed, the sessions are used right where they are in the file.
+  * @return the mapped table or NULL on failure
+*/
+SessionTable *attachTableFile( char const *path );
+
+/**
+  * Write the table back to its state file, does nothing for a System V segment.
+*/
+void checkpointTable( SessionTable *table );
+
+/**
+  * Detach a table, and remove the segment too if remove is true. A state file is never removed.
+*/
+void detachTable( SessionTable *table, bool remove );
+
+/**
+  * Start a new session on a free slot with a copy of the given board.
+  * @return the session id or -1 if every slot is in use, or the segment was removed by endSession
+*/
+int newSession( SessionTable *table, uint64_t const *rows, int size );
+
+/**
+  * End a session, returning its slot to the free list.
+  * @param removeIfLast true to remove a System V segment along with its last session. This is decided under the
+  *                     table's lock, so a session started at the same time is never removed with it
+  * @return true if the session was in use
+*/
+bool endSession( SessionTable *table, int id, bool removeIfLast );
+
+/**
+  * Find the slot for a session.
+  * @return the game state or NULL if the id isn't a live session
+*/
+GameState *findSession( SessionTable *table, int id );
+
+/**
+  * Rows of the board from before the last move.
+  * @param state the game state in shared memory
+  * @return pointer to the first previous row
+*/
+static inline uint64_t *previousRows( GameState *state ) {
+  return state->rows;
+}
+
+/**
+  * Rows of the board as it is now.
+  * @param state the game state in shared memory
+  * @return pointer to the first current row
+*/
+static inline uint64_t *currentRows( GameState *state ) {
+  return state->rows + state->size;
+}
+
+/**
+  * Mask with a bit set for every column of a row.
+  * @param size height and width of the board
+  * @return the row mask
+*/
+static inline uint64_t rowMask( int size ) {
+  return size == 64 ? ~( uint64_t )0 : ( ( uint64_t )1 << size ) - 1;
+}
+
+/**
+  * Toggle the light at the given cell and its four neighbors. Neighbors in the same row are one
+  * shift of the column bit, and the rows above and below just flip the column bit.
+  * @param rows the rows of the board
+  * @param size height and width of the board
+  * @param r the row pressed, must be on the board
+  * @param c the column pressed, must be on the board
+*/
+static inline void pressCell( uint64_t *rows, int size, int r, int c ) {
+  uint64_t bit = ( uint64_t )1 << c;
+  rows[ r ] ^= ( bit | ( bit << 1 ) | ( bit >> 1 ) ) & rowMask( size );
+  if( r > 0 )
+    rows[ r - 1 ] ^= bit;
+  if( r < size - 1 )
+    rows[ r + 1 ] ^= bit;
+}
+
+/**
+  * Pack the rows of a small board into one number, the light at row r, column c is bit r * size + c.
+  * This is how boards are numbered in the hint table.
+  * @param rows the rows of the board
+  * @param size height and width of the board, HINT_SIZE for the hint table
+  * @return the packed board
+*/
+static inline uint32_t hintIndex( uint64_t const *rows, int size ) {
+  uint32_t index = 0;
+  for( int r = 0; r < size; r++ ) {
+    index |= ( uint32_t ) rows[ r ] << ( r * size );
+  }
+  return index;
+}
+
+/**
+  * Acquire the writer lock on the board, failing if the session has ended. If the previous owner
+  * died while holding it we repair the board before continuing: an odd seq means it died while
+  * changing the current rows, and the previous rows still hold the complete board from before that change.
+  * @param state the game state in shared memory
+  * @return true if we now hold the lock
+*/
+static inline bool lockGame( GameState *state ) {
+  int rc = pthread_mutex_lock( &state->lock );
+
+  if( rc == EOWNERDEAD ) {
+    unsigned seq = atomic_load_explicit( &state->seq, memory_order_relaxed );
+    if( seq & 1 ) {
+      memcpy( currentRows( state ), previousRows( state ), state->size * sizeof( uint64_t ) );
+      atomic_store_explicit( &state->seq, seq + 1, memory_order_release );
+    }
+
+    else {
+      // it may have died part way through saving the previous rows, so don't trust them for undo
+      state->isMoved = false;
+    }
+
+    pthread_mutex_consistent( &state->lock );
+    rc = 0;
+  }
+
+  // the session may have ended while we were waiting
+  if( rc == 0 && !state->inUse ) {
+    pthread_mutex_unlock( &state->lock );
+    return false;
+  }
+
+  return rc == 0;
+}
+
+/**
+  * Release the writer lock on the board.
+  * @param state the game state in shared memory
+*/
+static inline void unlockGame( GameState *state ) {
+  pthread_mutex_unlock( &state->lock );
+}
+
+/**
+  * Called by a writer holding the lock right before it changes the current rows.
+  * @param state the game state in shared memory
+*/
+static inline void beginWrite( GameState *state ) {
+  atomic_fetch_add_explicit( &state->seq, 1, memory_order_relaxed );
+  atomic_thread_fence( memory_order_release );
+}
+
+/**
+  * Called by a writer holding the lock right after it is done changing the current rows.
+  * @param state the game state in shared memory
+*/
+static inline void endWrite( GameState *state ) {
+  atomic_fetch_add_explicit( &state->seq, 1, memory_order_release );
+}
+
+/**
+  * Copy a consistent snapshot of the current rows without taking the lock, so readers never
+  * block writers. We retry if a writer was active before or during the copy. If that keeps
+  * happening the writer may have died part way through, so we take the lock, which repairs the
+  * board, and copy it under the lock.
+  * @param state the game state in shared memory
+  * @param board where to store the snapshot, must hold state->size rows
+*/
+static inline void readBoard( GameState *state, uint64_t *board ) {
+  for( int retries = 0; retries < READ_RETRY_LIMIT; retries++ ) {
+    unsigned before = atomic_load_explicit( &state->seq, memory_order_acquire );
+
+    // a writer is part way through a change, let it finish
+    if( before & 1 ) {
+      sched_yield();
+      continue;
+    }
+
+    // volatile so the compiler can't move the copy outside the two seq loads
+    volatile uint64_t *src = currentRows( state );
+    for( int i = 0; i < state->size; i++ ) {
+      board[ i ] = src[ i ];
+    }
+
+    atomic_thread_fence( memory_order_acquire );
+    if( atomic_load_explicit( &state->seq, memory_order_relaxed ) == before ) {
+      return;
+    }
+  }
+
+  // a session that ended has no board worth repairing, what's there is as good as any
+  bool locked = lockGame( state );
+  memcpy( board, currentRows( state ), state->size * sizeof( uint64_t ) );
+  if( locked ) {
+    unlockGame( state );
+  }
+}
+
+#endif
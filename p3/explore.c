@@ -0,0 +1,288 @@
+/**
+  * @file explore.c
+  * @author Jake Donovan (jmpatte8)
+  * This file is responsible for exploring every state of the 5x5 lightsout board. Starting from the board with every
+  * light off, it runs a breadth-first search using the same moves lightsout makes, so the level a board is found on
+  * is the fewest moves that solve it. The search runs on several threads, each with its own frontier, and claims
+  * boards in a shared visited bitset. The answers are written to a hint table that lightsout maps for its hint command.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "common.h"
+
+// Number of states in a chunk of frontier that a thread takes at once.
+#define CHUNK 4096
+
+// Most threads we will run.
+#define MAX_THREADS 64
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+  fprintf( stderr, "%s\n", message );
+  exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+  fprintf( stderr, "usage: explore [-t <threads>] [-o <table-file>]\n" );
+  exit( 1 );
+}
+
+/** A growable list of board states, one per thread per level. */
+typedef struct {
+  // the states
+  uint32_t *list;
+  // number of states in the list
+  size_t count;
+  // number of states there is room for
+  size_t capacity;
+} Frontier;
+
+/** Toggle mask for each of the HINT_CELLS moves, as a packed board index. */
+static uint32_t moveMask[ HINT_CELLS ];
+
+/** One bit per state, set once some thread has claimed the state. */
+static atomic_uint_least64_t *visited;
+
+/** Hint table entries, two per byte, filled in as states are claimed. */
+static atomic_uchar *table;
+
+/** Frontiers for the level being expanded, one per thread. */
+static Frontier *current;
+
+/** Frontiers for the next level, one per thread. */
+static Frontier *next;
+
+/** Number of worker threads. */
+static int threads;
+
+/** Level being expanded, this is the number of moves to solve states in current. */
+static int level;
+
+/** Number of chunks in the current level, and the next chunk a thread should take. */
+static size_t chunkCount;
+static atomic_size_t nextChunk;
+
+/**
+  * Add a state to a frontier, making room if needed.
+  * @param front the frontier
+  * @param state the packed board
+*/
+static void addState( Frontier *front, uint32_t state ) {
+  if( front->count == front->capacity ) {
+    front->capacity = front->capacity ? front->capacity * 2 : CHUNK;
+    front->list = ( uint32_t * )realloc( front->list, front->capacity * sizeof( uint32_t ) );
+    if( !front->list ) {
+      fail( "Out of memory" );
+    }
+  }
+
+  front->list[ front->count++ ] = state;
+}
+
+/**
+  * Claim a state for this level if nobody has found it yet, recording its move count.
+  * @param state the packed board
+  * @param moves fewest moves that solve it
+  * @return true if we claimed it
+*/
+static bool claim( uint32_t state, int moves ) {
+  atomic_uint_least64_t *word = visited + state / 64;
+  uint64_t bit = ( uint64_t )1 << ( state % 64 );
+
+  // a plain load first, most neighbors have already been seen
+  if( atomic_load_explicit( word, memory_order_relaxed ) & bit ) {
+    return false;
+  }
+
+  if( atomic_fetch_or_explicit( word, bit, memory_order_relaxed ) & bit ) {
+    return false;
+  }
+
+  atomic_fetch_or_explicit( table + state / 2, ( unsigned char )( moves << ( 4 * ( state % 2 ) ) ),
+                            memory_order_relaxed );
+  return true;
+}
+
+/**
+  * Start routine for each worker. Takes chunks of the current level from every thread's frontier
+  * and puts the newly found neighbors on its own frontier for the next level.
+  * @param arg pointer to the index of this thread
+*/
+static void *explorer( void *arg ) {
+  int self = *( int * )arg;
+
+  while( true ) {
+    size_t chunk = atomic_fetch_add( &nextChunk, 1 );
+    if( chunk >= chunkCount ) {
+      break;
+    }
+
+    // find the frontier this chunk falls in
+    size_t offset = chunk * CHUNK;
+    int owner = 0;
+    while( offset >= current[ owner ].count ) {
+      offset -= ( current[ owner ].count + CHUNK - 1 ) / CHUNK * CHUNK;
+      owner++;
+    }
+
+    size_t end = offset + CHUNK < current[ owner ].count ? offset + CHUNK : current[ owner ].count;
+    for( size_t i = offset; i < end; i++ ) {
+      uint32_t state = current[ owner ].list[ i ];
+      for( int m = 0; m < HINT_CELLS; m++ ) {
+        uint32_t neighbor = state ^ moveMask[ m ];
+        if( claim( neighbor, level + 1 ) ) {
+          addState( &next[ self ], neighbor );
+        }
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  * Seconds elapsed since the given time.
+  * @param start the starting time
+  * @return elapsed seconds
+*/
+static double elapsed( struct timespec *start ) {
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return ( now.tv_sec - start->tv_sec ) + ( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
+
+/**
+  * Program starting point. Runs the search one level at a time and writes the hint table.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+  threads = sysconf( _SC_NPROCESSORS_ONLN );
+  char const *path = HINT_FILE;
+  for( int i = 1; i < argc; i += 2 ) {
+    if( i + 1 >= argc ) {
+      usage();
+    }
+
+    if( strcmp( argv[ i ], "-t" ) == 0 ) {
+      if( sscanf( argv[ i + 1 ], "%d", &threads ) != 1 ) {
+        usage();
+      }
+    }
+
+    else if( strcmp( argv[ i ], "-o" ) == 0 ) {
+      path = argv[ i + 1 ];
+    }
+
+    else {
+      usage();
+    }
+  }
+
+  if( threads < 1 || threads > MAX_THREADS ) {
+    fail( "Thread count must be between 1 and 64" );
+  }
+
+  // the move masks come straight from the move lightsout makes
+  for( int r = 0; r < HINT_SIZE; r++ ) {
+    for( int c = 0; c < HINT_SIZE; c++ ) {
+      uint64_t rows[ HINT_SIZE ] = { 0 };
+      pressCell( rows, HINT_SIZE, r, c );
+      moveMask[ r * HINT_SIZE + c ] = hintIndex( rows, HINT_SIZE );
+    }
+  }
+
+  visited = calloc( HINT_STATES / 64, sizeof( *visited ) );
+  table = calloc( HINT_STATES / 2, sizeof( *table ) );
+  current = calloc( threads, sizeof( Frontier ) );
+  next = calloc( threads, sizeof( Frontier ) );
+  if( !visited || !table || !current || !next ) {
+    fail( "Out of memory" );
+  }
+
+  struct timespec start;
+  clock_gettime( CLOCK_MONOTONIC, &start );
+
+  // the board with every light off is already solved
+  claim( 0, 0 );
+  addState( &current[ 0 ], 0 );
+
+  pthread_t thread[ MAX_THREADS ];
+  int index[ MAX_THREADS ];
+  long solvable = 1;
+  printf( "moves  boards\n" );
+  printf( "%5d  %8d\n", 0, 1 );
+
+  for( level = 0; ; level++ ) {
+    chunkCount = 0;
+    for( int i = 0; i < threads; i++ ) {
+      chunkCount += ( current[ i ].count + CHUNK - 1 ) / CHUNK;
+      next[ i ].count = 0;
+    }
+
+    if( chunkCount == 0 ) {
+      break;
+    }
+
+    atomic_store( &nextChunk, 0 );
+    for( int i = 0; i < threads; i++ ) {
+      index[ i ] = i;
+      if( pthread_create( &thread[ i ], NULL, explorer, &index[ i ] ) != 0 ) {
+        fail( "Can't create thread" );
+      }
+    }
+
+    long found = 0;
+    for( int i = 0; i < threads; i++ ) {
+      pthread_join( thread[ i ], NULL );
+      found += next[ i ].count;
+    }
+
+    if( found > 0 ) {
+      printf( "%5d  %8ld\n", level + 1, found );
+      solvable += found;
+    }
+
+    // the next level becomes the current one, reusing the old lists
+    Frontier *swap = current;
+    current = next;
+    next = swap;
+  }
+
+  double seconds = elapsed( &start );
+  printf( "solvable: %ld of %ld boards\n", solvable, ( long ) HINT_STATES );
+  printf( "threads: %d  time: %.3f s\n", threads, seconds );
+
+  // a table entry of 0 for any board but the solved one means the board can't be solved
+  HintHeader header = { HINT_MAGIC, HINT_SIZE };
+  int fd = open( path, O_WRONLY | O_CREAT | O_TRUNC, 0666 );
+  if( fd == -1 ) {
+    fail( "Can't create hint table" );
+  }
+
+  if( write( fd, &header, sizeof( header ) ) != sizeof( header ) ||
+      write( fd, ( void * )table, HINT_STATES / 2 ) != HINT_STATES / 2 ) {
+    fail( "Can't write hint table" );
+  }
+
+  close( fd );
+  for( int i = 0; i < threads; i++ ) {
+    free( current[ i ].list );
+    free( next[ i ].list );
+  }
+  free( current );
+  free( next );
+  free( ( void * )table );
+  free( ( void * )visited );
+  return 0;
+}
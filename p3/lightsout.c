@@ -2,6 +2,8 @@
   * @file lightsout.c
   * @author Jake Donovan (jmpatte8)
   * This class is able to accept commands for move, undo, exit, report, and test for lightsout game
+  * Every command names the session it applies to, e.g. "lightsout 3 move 1 2", optionally after -f <state-file>
+  * to use sessions kept in a state file. Compile with session.c.
 */
 
 #include <stdlib.h>
@@ -10,7 +12,9 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/shm.h>
+#include <sys/mman.h>
 #include <errno.h>
 #include <string.h>
 #include "common.h"
@@ -24,377 +28,121 @@ static void fail( char const *message ) {
 // Make a move at the given row, column location, returning true
 // if successful.
 bool move( GameState *state, int r, int c ) {
-  if( r >= 0 && r < GRID_SIZE && c >= 0 && c < GRID_SIZE ) {
-    // save current state as previous state
-    for( int i = 0; i < GRID_SIZE; i++ ) {
-      for( int j = 0; j < GRID_SIZE; j++ ) {
-        state->previousState[ i ][ j ] = state->currentState[ i ][ j ];
-      }
-    }
-
-    // set isMoved to true everywhere
-
-    // top  left corner
-    if( r == 0 && c == 0 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
-
-      if( state->currentState[ r ][ c + 1 ] == '.' ) {
-        state->currentState[ r ][ c + 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c + 1 ] = '.';
-      }
-
-      if( state->currentState[ r + 1 ][ c ] == '.' ) {
-        state->currentState[ r + 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r + 1 ][ c ] = '.';
-      }
-
-      state->isMoved = true;
-      return true;
-    }
-
-    //  top right corner
-    else if( r == 0 && c == 4 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
-
-      if( state->currentState[ r ][ c - 1 ] == '.' ) {
-        state->currentState[ r ][ c - 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c - 1 ] = '.';
-      }
-
-      if( state->currentState[ r + 1 ][ c ] == '.' ) {
-        state->currentState[ r + 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r + 1 ][ c ] = '.';
-      }
-
-      state->isMoved = true;
-      return true;
-    }
-
-    // top center rows
-    else if( r == 0 && c > 0 && c < 4 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
-
-      if( state->currentState[ r ][ c - 1 ] == '.' ) {
-        state->currentState[ r ][ c - 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c - 1 ] = '.';
-      }
-
-      if( state->currentState[ r ][ c + 1 ] == '.' ) {
-        state->currentState[ r ][ c + 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c + 1 ] = '.';
-      }
-
-      if( state->currentState[ r + 1 ][ c ] == '.' ) {
-        state->currentState[ r + 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r + 1 ][ c ] = '.';
-      }
-
-      state->isMoved = true;
-      return true;
-    }
-
-    // bottom left corner
-    else if( r == 4 && c == 0 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
-
-      if( state->currentState[ r - 1 ][ c ] == '.' ) {
-        state->currentState[ r - 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r - 1 ][ c ] = '.';
-      }
-
-      if( state->currentState[ r ][ c + 1 ] == '.' ) {
-        state->currentState[ r ][ c + 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c + 1 ] = '.';
-      }
-
-      state->isMoved = true;
-      return true;
-    }
-
-    // bottom right corner
-    else if( r == 4 && c == 4 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
-
-      if( state->currentState[ r ][ c - 1 ] == '.' ) {
-        state->currentState[ r ][ c - 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c - 1 ] = '.';
-      }
-
-      if( state->currentState[ r - 1 ][ c ] == '.' ) {
-        state->currentState[ r - 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r - 1 ][ c ] = '.';
-      }
-
-      state->isMoved = true;
-      return true;
-    }
-
-    // bottom middle rows
-    else if( r == 4 && c > 0 && c < 4 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
-
-      if( state->currentState[ r ][ c - 1 ] == '.' ) {
-        state->currentState[ r ][ c - 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c - 1  ] = '.';
-      }
-
-      if( state->currentState[ r ][ c + 1 ] == '.' ) {
-        state->currentState[ r ][ c + 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c + 1 ] = '.';
-      }
-
-      if( state->currentState[ r - 1 ][ c ] == '.' ) {
-        state->currentState[ r - 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r - 1 ][ c ] = '.';
-      }
-
-      state->isMoved = true;
-      return true;
-    }
-
-    // far left center rows
-    else if( r > 0 && r < 4 && c == 0 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
-
-      if( state->currentState[ r - 1 ][ c ] == '.' ) {
-        state->currentState[ r - 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r - 1 ][ c ] = '.';
-      }
-
-      if( state->currentState[ r + 1 ][ c ] == '.' ) {
-        state->currentState[ r + 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r + 1 ][ c ] = '.';
-      }
-
-      if( state->currentState[ r ][ c + 1 ] == '.' ) {
-        state->currentState[ r ][ c + 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c + 1 ] = '.';
-      }
-
-      state->isMoved = true;
-      return true;
-    }
-
-    // center of board
-    else if( r > 0 && r < 4 && c > 0 && c < 4 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
+  if( !lockGame( state ) ) {
+    return false;
+  }
 
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
+  // the session could have been ended and its slot given a new board while we waited, so the
+  // size is only checked once we hold the lock
+  if( r < 0 || r >= state->size || c < 0 || c >= state->size ) {
+    unlockGame( state );
+    return false;
+  }
 
-      if( state->currentState[ r ][ c - 1 ] == '.' ) {
-        state->currentState[ r ][ c - 1 ] = '*';
-      }
+  // save current state as previous state, report only reads the current rows so this
+  // doesn't need to be inside the write
+  memcpy( previousRows( state ), currentRows( state ), state->size * sizeof( uint64_t ) );
 
-      else {
-        state->currentState[ r ][ c - 1 ] = '.';
-      }
+  beginWrite( state );
+  pressCell( currentRows( state ), state->size, r, c );
+  endWrite( state );
 
-      if( state->currentState[ r ][ c + 1 ] == '.' ) {
-        state->currentState[ r ][ c + 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c + 1 ] = '.';
-      }
+  state->isMoved = true;
+  unlockGame( state );
+  return true;
+}
 
-      if( state->currentState[ r + 1 ][ c ] == '.' ) {
-        state->currentState[ r + 1 ][ c ] = '*';
-      }
+// Undo the most recent move, returning true if successful.
+bool undo( GameState *state ) {
+  if( !lockGame( state ) ) {
+    return false;
+  }
 
-      else {
-        state->currentState[ r + 1 ][ c ] = '.';
-      }
+  bool undone = false;
+  if( state->isMoved ) {
+    beginWrite( state );
+    memcpy( currentRows( state ), previousRows( state ), state->size * sizeof( uint64_t ) );
+    endWrite( state );
 
-      if( state->currentState[ r - 1 ][ c ] == '.' ) {
-        state->currentState[ r - 1 ][ c ] = '*';
-      }
+    state->isMoved = false;
+    undone = true;
+  }
 
-      else {
-        state->currentState[ r - 1 ][ c ] = '.';
-      }
+  unlockGame( state );
+  return undone;
+}
 
-      state->isMoved = true;
-      return true;
+// Print the current state of the board.
+void report( GameState *state ) { 
+  // take a snapshot without the lock so we never hold up a move
+  uint64_t board[ MAX_GRID_SIZE ];
+  readBoard( state, board );
+
+  // build each row as a string so a big board is one printf per row
+  char line[ MAX_GRID_SIZE + 1 ];
+  for( int i = 0; i < state->size; i++ ) {
+    for( int j = 0; j < state->size; j++ ) {
+      line[ j ] = ( board[ i ] >> j ) & 1 ? '*' : '.';
     }
+    line[ state->size ] = '\0';
+    printf( "%s\n", line );
+  }
+}
 
-    // far right center rows
-    else if( r > 0 && r < 4 && c == 4 ) {
-      if( state->currentState[ r ][ c ] == '.' ) {
-        state->currentState[ r ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c ] = '.';
-      }
-
-      if( state->currentState[ r ][ c - 1 ] == '.' ) {
-        state->currentState[ r ][ c - 1 ] = '*';
-      }
-
-      else {
-        state->currentState[ r ][ c - 1 ] = '>';
-      }
-
-      if( state->currentState[ r - 1 ][ c ] == '.' ) {
-        state->currentState[ r - 1 ][ c ] = '*';
-      }
-
-      else {
-        state->currentState[ r - 1 ][ c ] = '.';
-      }
-
-      if( state->currentState[ r + 1 ][ c ] == '.' ) {
-        state->currentState[ r + 1 ][ c ] = '*';
-      }
+// Print the fewest moves that solve the current board, looked up in the hint
+// table made by explore. Returns false if there is no table for this board.
+bool hint( GameState *state ) {
+  if( state->size != HINT_SIZE ) {
+    return false;
+  }
 
-      else {
-        state->currentState[ r + 1 ][ c ] = '.';
-      }
+  int fd = open( HINT_FILE, O_RDONLY );
+  if( fd == -1 ) {
+    return false;
+  }
 
-      state->isMoved = true;
-      return true;
-    }
+  // a truncated or stale file would fault when we touch the part that isn't there
+  size_t bytes = sizeof( HintHeader ) + HINT_STATES / 2;
+  struct stat info;
+  if( fstat( fd, &info ) != 0 || info.st_size != ( off_t ) bytes ) {
+    close( fd );
+    return false;
+  }
 
-    else {
-      return false;
-    }
+  // map the table instead of reading it, we only need one entry out of it
+  unsigned char *map = ( unsigned char * )mmap( NULL, bytes, PROT_READ, MAP_SHARED, fd, 0 );
+  close( fd );
+  if( map == MAP_FAILED ) {
+    return false;
   }
 
-  else {
+  HintHeader *header = ( HintHeader * )map;
+  if( header->magic != HINT_MAGIC || header->size != HINT_SIZE ) {
+    munmap( map, bytes );
     return false;
   }
-}
 
-// Undo the most recent move, returning true if successful.
-bool undo( GameState *state ) {
-  if( state->isMoved ) {
-    for( int i = 0; i < GRID_SIZE; i++ ) {
-      for( int j = 0; j < GRID_SIZE; j++ ) {
-        state->currentState[ i ][ j ] = state->previousState[ i ][ j ];
-      }
-    }
+  uint64_t board[ MAX_GRID_SIZE ];
+  readBoard( state, board );
+  uint32_t index = hintIndex( board, HINT_SIZE );
+  int moves = ( map[ sizeof( HintHeader ) + index / 2 ] >> ( 4 * ( index % 2 ) ) ) & 0xF;
+  munmap( map, bytes );
 
-    state->isMoved = false;
-    return true;
+  if( index != 0 && moves == 0 ) {
+    printf( "unsolvable\n" );
   }
 
   else {
-    return false;
+    printf( "%d\n", moves );
   }
-}
 
-// Print the current state of the board.
-void report( GameState *state ) { 
-  // THIS WILL WORK FOR REPORT
-  for( int i = 0; i < GRID_SIZE; i++ ) {
-    for( int j = 0; j < GRID_SIZE; j++ ) {
-      printf("%c", state->currentState[ i ][ j ]);
-    }
-    printf("\n");
-  }
+  return true;
 }
 
 // Test interface, for quickly making a given move over and over.
 bool test( GameState *state, int n, int r, int c ) {
   // Make sure the row / colunn is valid.
-  if ( r < 0 || r >= GRID_SIZE || c < 0 || c >= GRID_SIZE )
+  if ( r < 0 || r >= state->size || c < 0 || c >= state->size )
   return false;
   
   // Make the same move a bunch of times.
@@ -404,48 +152,70 @@ bool test( GameState *state, int n, int r, int c ) {
 }
 
 
-//
-bool exitFunction( int schmid ) {
-  // Tell the OS we no longer need the segment.
-  shmctl( schmid, IPC_RMID, 0 );
+// End the given session, returning true if successful. Once the last
+// session has ended the segment itself is removed.
+bool exitFunction( SessionTable *table, int id ) {
+  // whether it was the last one is decided under the table's lock, a session started at
+  // the same time could be lost with the segment otherwise
+  if( !endSession( table, id, true ) ) {
+    return false;
+  }
+
+  checkpointTable( table );
+
   // return true
   return true;
 }
 
 
 /**
-  * 
+  * Program starting point. Runs one command against the given session.
   * @param argc the number of command line arguments 
   * @param argv a char pointer to command line arguments 
   * @return program exit status
 */
 int main( int argc, char *argv[] ) {
-  // Retrieve shared memory
-  int schmid = shmget( ftok( ".", 1 ), BLOCK_SIZE, 0666 );
+  // the sessions live in a state file instead of System V shared memory when given -f
+  char const *stateFile = NULL;
+  if( argc > 2 && strcmp( argv[ 1 ], "-f" ) == 0 ) {
+    stateFile = argv[ 2 ];
+    argc -= 2;
+    argv += 2;
+  }
+
+  // Retrieve the session table reset made
+  SessionTable *table = stateFile ? attachTableFile( stateFile ) : attachTable( ftok( ".", 1 ) );
   
-  // Check schmid
-  if( schmid == -1 ){
+  // Check table
+  if( !table ){
     fail( "error" );
   }
 
-  // Get shared memory game state
-  GameState * state = ( GameState * )shmat( schmid, 0, 0 );
-
-  // Check state
-  if( state == ( GameState *)-1 ){
+  // every command starts with the session it applies to
+  int id = 0;
+  if( argc < 3 || sscanf( argv[ 1 ], "%d", &id ) != 1 ) {
     fail( "error" );
   }
-  
-  if( argc < 2 ) {
+
+  // Get the game state for this session
+  GameState * state = findSession( table, id );
+
+  // Check state
+  if( !state ){
     fail( "error" );
   }
 
-  // most likely a undo, report, or exit command
+  // drop the session id so the rest of the command looks the same as it always has
+  argc--;
+  argv++;
+
+  // most likely a undo, report, hint, or exit command
   if( argc ==  2 ) {
     // undo command
     if( strcmp( argv[ 1 ], "undo" ) == 0 ) {
       // if a move commmand has been performed
       if( undo( state ) ) {
+        checkpointTable( table );
         printf( "success\n" );
       }
 
@@ -459,11 +229,21 @@ int main( int argc, char *argv[] ) {
       report( state );
     }
 
+    else if( strcmp( argv[ 1 ], "hint" ) == 0 ) {
+      if( !hint( state ) ) {
+        fail( "error" );
+      }
+    }
+
     else if( strcmp( argv[ 1 ], "exit" ) == 0 ) {
-      if( exitFunction( schmid ) ) {
+      if( exitFunction( table, id ) ) {
           // print success
           printf("success\n");
       }
+
+      else {
+        fail( "error" );
+      }
     }
 
     else {
@@ -492,6 +272,7 @@ int main( int argc, char *argv[] ) {
       }
 
       if( move( state, r, c )) {
+        checkpointTable( table );
         printf( "success\n" );
       }
 
@@ -535,6 +316,7 @@ int main( int argc, char *argv[] ) {
       }
 
       if( test( state, n, r, c ) ) {
+        checkpointTable( table );
         printf( "success\n" );
       }
 
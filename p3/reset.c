@@ -1,7 +1,8 @@
 /**
   * @file reset.c
   * @author Jake Donovan (jmpatte8)
-  * This file is responsible for creating a shared memory segment and initializing GameState for lightsout.c
+  * This file is responsible for creating a shared memory segment and initializing a GameState session for lightsout.c
+  * for each board file it is given. Compile with session.c.
 */
 
 #include <stdlib.h>
@@ -12,7 +13,6 @@
 #include <sys/types.h>
 #include <sys/shm.h>
 #include <errno.h>
-#include <string.h>
 #include <sys/ipc.h>
 #include <string.h>
 #include "common.h"
@@ -25,12 +25,73 @@ static void fail( char const *message ) {
 
 // Print out a usage message and exit.
 static void usage() {
-  fprintf( stderr, "usage: reset <board-file>\n" );
+  fprintf( stderr, "usage: reset [-f <state-file>] [-c <capacity>] <board-file> ...\n" );
+  fprintf( stderr, "       reset [-f <state-file>] -a <board-file> ...\n" );
+  exit( 1 );
+}
+
+// Print out a message about a bad board file and exit.
+static void invalidFile( char const *fileName ) {
+  fprintf( stderr, "Invalid input file: %s\n", fileName );
   exit( 1 );
 }
 
 /**
-  * Program starting point. Creates a shared memory space and initializes GameState for lightsout.c
+  * Read a board from the given file. Every line has to be the same length as there are lines,
+  * made up of '.' for a light that is off and '*' for a light that is on.
+  * @param fp the board file
+  * @param fileName name of the board file for error messages
+  * @param rows where to store the rows, bit c of a row is set when column c is on
+  * @return height and width of the board
+*/
+static int readBoardFile( FILE *fp, char const *fileName, uint64_t rows[ MAX_GRID_SIZE ] ) {
+  // leave room for the newline, the terminator and one more character so we notice long lines
+  char line[ MAX_GRID_SIZE + 3 ];
+  int size = 0;
+  int rowIdx = 0;
+
+  while( fgets( line, sizeof( line ), fp ) ) {
+    int len = strcspn( line, "\r\n" );
+
+    // ignore a blank line at the end of the file
+    if( len == 0 ) {
+      continue;
+    }
+
+    // the first row decides how big the board is
+    if( rowIdx == 0 ) {
+      size = len;
+    }
+
+    if( len != size || size > MAX_GRID_SIZE || rowIdx >= size ) {
+      invalidFile( fileName );
+    }
+
+    rows[ rowIdx ] = 0;
+    for( int colIdx = 0; colIdx < len; colIdx++ ) {
+      if( line[ colIdx ] == '*' ) {
+        rows[ rowIdx ] |= ( uint64_t )1 << colIdx;
+      }
+
+      else if( line[ colIdx ] != '.' ) {
+        invalidFile( fileName );
+      }
+    }
+
+    rowIdx++;
+  }
+
+  if( size == 0 || rowIdx != size ) {
+    invalidFile( fileName );
+  }
+
+  return size;
+}
+
+/**
+  * Program starting point. Creates a shared memory space and starts a lightsout session for each board file,
+  * printing the session id for each one. With -a the sessions are added to the existing segment instead, and
+  * with -f the sessions are kept in the given state file instead of System V shared memory.
   * @param argc the number of command line arguments
   * @param argv a char pointer to an array of command line arguments
   * @return program exit status
@@ -44,63 +105,92 @@ int main( int argc, char *argv[] ) {
     fail( "Key could not be created using ftok" );
   }
 
-  // key is 20273507
+  // look for options before the board files
+  bool add = false;
+  int capacity = 0;
+  char const *stateFile = NULL;
+  int argIdx = 1;
+  while( argIdx < argc && argv[ argIdx ][ 0 ] == '-' ) {
+    if( strcmp( argv[ argIdx ], "-a" ) == 0 ) {
+      add = true;
+      argIdx++;
+    }
+
+    else if( strcmp( argv[ argIdx ], "-f" ) == 0 && argIdx + 1 < argc ) {
+      stateFile = argv[ argIdx + 1 ];
+      argIdx += 2;
+    }
+
+    else if( strcmp( argv[ argIdx ], "-c" ) == 0 && argIdx + 1 < argc &&
+             sscanf( argv[ argIdx + 1 ], "%d", &capacity ) == 1 && capacity > 0 ) {
+      argIdx += 2;
+    }
+
+    else {
+      usage();
+    }
+  }
 
-  if( argc != 2 ) {
+  int boards = argc - argIdx;
+  if( boards < 1 || ( add && capacity != 0 ) ) {
     usage();
   }
 
-  // create a file pointer
-  FILE *fp = fopen( argv[ 1 ], "r" );
+  // read every board before touching the segment so a bad file doesn't leave half the sessions behind
+  uint64_t ( *rows )[ MAX_GRID_SIZE ] = malloc( boards * sizeof( *rows ) );
+  int *sizes = ( int * )malloc( boards * sizeof( int ) );
+  for( int i = 0; i < boards; i++ ) {
+    // create a file pointer
+    FILE *fp = fopen( argv[ argIdx + i ], "r" );
+
+    // check if the file could be opened
+    if( !fp ) {
+      invalidFile( argv[ argIdx + i ] );
+    }
+
+    sizes[ i ] = readBoardFile( fp, argv[ argIdx + i ], rows[ i ] );
+    fclose( fp );
+  }
 
-  // check if the file could be opened
-  if( !fp ) {
-    char * fileName = argv [ 1 ];
-    char * message = "Invalid input file: ";
-    char * result = strcat( message, fileName );
-    fail( result );
+  SessionTable *table;
+  if( add ) {
+    table = stateFile ? attachTableFile( stateFile ) : attachTable( key );
+    if( !table ) {
+      fail( "Can't find shared memory, run reset without -a first" );
+    }
   }
 
   else {
-    // create shared memory and initialize board
-    int schmid = shmget( key, BLOCK_SIZE, 0666 | IPC_CREAT );
+    // make room for every board, and some extra sessions to add later
+    if( capacity == 0 ) {
+      capacity = boards > DEFAULT_SESSIONS ? boards : DEFAULT_SESSIONS;
+    }
 
-    if( schmid == -1 ) {
-      fail( "Can't create shared memory" );
+    if( capacity < boards ) {
+      fail( "Capacity is smaller than the number of boards" );
     }
 
-    GameState * state = ( GameState * )shmat( schmid, 0, 0 );
-    // declare an int to get each character from passed file
-    int ch;
-    // row index
-    int rowIdx = 0;
-    // col index
-    int colIdx = 0;
-    // loop through contents of file
-    while( ( ch = fgetc( fp )) != -1 ) {
-      if( colIdx == 4  && ch != '\n') {
-        state->previousState[ rowIdx ][ colIdx ] = ch;
-        state->currentState[ rowIdx ][ colIdx ] = ch;
-        rowIdx++;
-        colIdx = 0;
-      }
+    table = stateFile ? createTableFile( stateFile, capacity ) : createTable( key, capacity );
+    if( !table ) {
+      fail( "Can't create shared memory" );
+    }
+  }
 
-      else if( colIdx < 4  && ch != '\n') {
-        state->currentState[ rowIdx ][ colIdx ] = ch;
-        state->currentState[ rowIdx ][ colIdx ] = ch;
-        colIdx++;
-      }
+  for( int i = 0; i < boards; i++ ) {
+    int id = newSession( table, rows[ i ], sizes[ i ] );
+    if( id == -1 ) {
+      fail( "No free session slots" );
     }
 
-    // set is move to false
-    state->isMoved = false;
-    
-    // Release our reference to the shared memory segment.
-    shmdt( state );
-    // close file
-    fclose( fp );
+    printf( "%d\n", id );
   }
 
+  // Make sure the new sessions are on disk, then release our reference to the shared memory segment.
+  checkpointTable( table );
+  detachTable( table, false );
+  free( sizes );
+  free( rows );
+
   // exit successfully
   return 0;
 }
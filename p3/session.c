@@ -0,0 +1,364 @@
+/**
+  * @file session.c
+  * @author Jake Donovan (jmpatte8)
+  * This file is responsible for the session table at the start of the shared memory segment. Each session is a
+  * slot in the table, and slots that aren't in use are kept on a free list so ending a session and starting a new
+  * one reuses its slot. The table can live in a System V shared memory segment, or in a file we map so the games
+  * survive a reboot. Compile this along with lightsout.c, reset.c and the other programs that use the segment.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "common.h"
+
+/**
+  * Initialize a process-shared, robust mutex. Process-shared so every process attaching the segment
+  * can use it, and robust so a process killed while holding it doesn't leave it locked forever.
+  * @param lock the mutex to initialize
+  * @return true if successful
+*/
+static bool initSharedLock( pthread_mutex_t *lock ) {
+  pthread_mutexattr_t attr;
+  if( pthread_mutexattr_init( &attr ) != 0 ) {
+    return false;
+  }
+
+  pthread_mutexattr_setpshared( &attr, PTHREAD_PROCESS_SHARED );
+  pthread_mutexattr_setrobust( &attr, PTHREAD_MUTEX_ROBUST );
+  int rc = pthread_mutex_init( lock, &attr );
+  pthread_mutexattr_destroy( &attr );
+  return rc == 0;
+}
+
+/**
+  * Lock the table. If a process died holding it, the free list is short and simple enough
+  * that we just mark the lock consistent and carry on.
+  * @param table the session table
+*/
+static void lockTable( SessionTable *table ) {
+  if( pthread_mutex_lock( &table->lock ) == EOWNERDEAD ) {
+    pthread_mutex_consistent( &table->lock );
+  }
+}
+
+/**
+  * Check that a segment was made by reset with the layout we expect.
+  * @param table the attached segment
+  * @return true if it is a usable session table
+*/
+static bool validTable( SessionTable *table ) {
+  return table->magic == STATE_MAGIC && table->version == STATE_VERSION && table->capacity > 0;
+}
+
+/**
+  * Fill in the header and free list of a freshly created table.
+  * @param table the new table
+  * @param shmId id of the System V segment, or -1 for a mapped file
+  * @param capacity number of session slots
+  * @return true if successful
+*/
+static bool initTable( SessionTable *table, int shmId, int capacity ) {
+  table->shmId = shmId;
+  table->capacity = capacity;
+  table->used = 0;
+  if( !initSharedLock( &table->lock ) ) {
+    return false;
+  }
+
+  // every slot starts out free, linked in order so the first sessions get the lowest ids
+  for( int i = 0; i < capacity; i++ ) {
+    GameState *state = table->slots + i;
+    state->inUse = false;
+    state->nextFree = i + 1 < capacity ? i + 1 : -1;
+    state->size = 0;
+    state->isMoved = false;
+    atomic_init( &state->seq, 0 );
+    if( !initSharedLock( &state->lock ) ) {
+      return false;
+    }
+  }
+  table->freeHead = 0;
+
+  // nobody will use the segment until they see these
+  table->version = STATE_VERSION;
+  atomic_thread_fence( memory_order_release );
+  table->magic = STATE_MAGIC;
+  return true;
+}
+
+SessionTable *createTable( key_t key, int capacity ) {
+  // an old segment may be the wrong size, so get rid of it first. Anyone
+  // still attached keeps the old one until they detach.
+  int oldId = shmget( key, 0, 0666 );
+  if( oldId != -1 ) {
+    shmctl( oldId, IPC_RMID, 0 );
+  }
+
+  int schmid = shmget( key, tableBytes( capacity ), 0666 | IPC_CREAT | IPC_EXCL );
+  if( schmid == -1 ) {
+    return NULL;
+  }
+
+  SessionTable *table = ( SessionTable * )shmat( schmid, 0, 0 );
+  if( table == ( SessionTable * )-1 ) {
+    return NULL;
+  }
+
+  table->bootId[ 0 ] = '\0';
+  if( !initTable( table, schmid, capacity ) ) {
+    shmdt( table );
+    return NULL;
+  }
+
+  return table;
+}
+
+/**
+  * Read the id the kernel picked for this boot, so we can tell when a state file was last
+  * used before a reboot.
+  * @param bootId where to store the id, BOOT_ID_LIMIT bytes
+*/
+static void readBootId( char *bootId ) {
+  bootId[ 0 ] = '\0';
+  FILE *fp = fopen( "/proc/sys/kernel/random/boot_id", "r" );
+  if( fp ) {
+    if( fgets( bootId, BOOT_ID_LIMIT, fp ) ) {
+      bootId[ strcspn( bootId, "\n" ) ] = '\0';
+    }
+    fclose( fp );
+  }
+}
+
+SessionTable *createTableFile( char const *path, int capacity ) {
+  // start over with an empty file, the old one may be the wrong size
+  int fd = open( path, O_RDWR | O_CREAT | O_TRUNC, 0666 );
+  if( fd == -1 ) {
+    return NULL;
+  }
+
+  size_t bytes = tableBytes( capacity );
+  if( ftruncate( fd, bytes ) != 0 ) {
+    close( fd );
+    return NULL;
+  }
+
+  SessionTable *table = ( SessionTable * )mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  close( fd );
+  if( table == MAP_FAILED ) {
+    return NULL;
+  }
+
+  readBootId( table->bootId );
+  if( !initTable( table, -1, capacity ) ) {
+    munmap( table, bytes );
+    return NULL;
+  }
+
+  checkpointTable( table );
+  return table;
+}
+
+SessionTable *attachTable( key_t key ) {
+  // the segment is already there, so we don't need to know how big it is
+  int schmid = shmget( key, 0, 0666 );
+  if( schmid == -1 ) {
+    return NULL;
+  }
+
+  SessionTable *table = ( SessionTable * )shmat( schmid, 0, 0 );
+  if( table == ( SessionTable * )-1 ) {
+    return NULL;
+  }
+
+  if( !validTable( table ) ) {
+    shmdt( table );
+    return NULL;
+  }
+
+  return table;
+}
+
+/**
+  * Make a table from a state file usable again after a reboot. The locks may still look held by
+  * processes from the last boot, so they are initialized again, and a board that was in the
+  * middle of a change is put back the way it was before the change.
+  * @param table the mapped table
+  * @return true if successful
+*/
+static bool recoverTable( SessionTable *table ) {
+  if( !initSharedLock( &table->lock ) ) {
+    return false;
+  }
+
+  for( int i = 0; i < table->capacity; i++ ) {
+    GameState *state = table->slots + i;
+    unsigned seq = atomic_load( &state->seq );
+    if( seq & 1 ) {
+      memcpy( currentRows( state ), previousRows( state ), state->size * sizeof( uint64_t ) );
+      atomic_store( &state->seq, seq + 1 );
+    }
+
+    if( !initSharedLock( &state->lock ) ) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+SessionTable *attachTableFile( char const *path ) {
+  int fd = open( path, O_RDWR );
+  if( fd == -1 ) {
+    return NULL;
+  }
+
+  // the file says how many slots there are, so map just the header first
+  struct stat info;
+  if( fstat( fd, &info ) != 0 || info.st_size < ( off_t ) sizeof( SessionTable ) ) {
+    close( fd );
+    return NULL;
+  }
+
+  SessionTable *table = ( SessionTable * )mmap( NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+  if( table == MAP_FAILED ) {
+    close( fd );
+    return NULL;
+  }
+
+  if( !validTable( table ) || ( size_t ) info.st_size < tableBytes( table->capacity ) ) {
+    munmap( table, info.st_size );
+    close( fd );
+    return NULL;
+  }
+
+  // only the first process to attach after a reboot should redo the locks, the file lock
+  // keeps two of them from doing it at once
+  char bootId[ BOOT_ID_LIMIT ];
+  readBootId( bootId );
+  if( strcmp( bootId, table->bootId ) != 0 ) {
+    flock( fd, LOCK_EX );
+    if( strcmp( bootId, table->bootId ) != 0 ) {
+      if( !recoverTable( table ) ) {
+        flock( fd, LOCK_UN );
+        munmap( table, info.st_size );
+        close( fd );
+        return NULL;
+      }
+
+      strcpy( table->bootId, bootId );
+      checkpointTable( table );
+    }
+    flock( fd, LOCK_UN );
+  }
+
+  close( fd );
+  return table;
+}
+
+void checkpointTable( SessionTable *table ) {
+  // System V segments don't have anything to write back to
+  if( table->shmId == -1 ) {
+    msync( table, tableBytes( table->capacity ), MS_SYNC );
+  }
+}
+
+void detachTable( SessionTable *table, bool remove ) {
+  // a state file outlives its sessions, that's the point of it
+  if( table->shmId == -1 ) {
+    munmap( table, tableBytes( table->capacity ) );
+    return;
+  }
+
+  // Tell the OS we no longer need the segment.
+  if( remove ) {
+    shmctl( table->shmId, IPC_RMID, 0 );
+  }
+
+  shmdt( table );
+}
+
+int newSession( SessionTable *table, uint64_t const *rows, int size ) {
+  if( size < 1 || size > MAX_GRID_SIZE ) {
+    return -1;
+  }
+
+  // take a slot off the free list, unless the segment went with the last session while we waited for it
+  lockTable( table );
+  int id = validTable( table ) ? table->freeHead : -1;
+  if( id == -1 ) {
+    pthread_mutex_unlock( &table->lock );
+    return -1;
+  }
+
+  GameState *state = table->slots + id;
+  table->freeHead = state->nextFree;
+  table->used++;
+
+  // nobody can be using a free slot, but the lock keeps the board and inUse changing together
+  // for any process that looked the slot up just before it was freed
+  if( pthread_mutex_lock( &state->lock ) == EOWNERDEAD ) {
+    pthread_mutex_consistent( &state->lock );
+  }
+
+  beginWrite( state );
+  state->size = size;
+  memcpy( currentRows( state ), rows, size * sizeof( uint64_t ) );
+  memcpy( previousRows( state ), rows, size * sizeof( uint64_t ) );
+  state->isMoved = false;
+  state->nextFree = -1;
+  state->inUse = true;
+  endWrite( state );
+
+  pthread_mutex_unlock( &state->lock );
+  pthread_mutex_unlock( &table->lock );
+  return id;
+}
+
+bool endSession( SessionTable *table, int id, bool removeIfLast ) {
+  if( id < 0 || id >= table->capacity ) {
+    return false;
+  }
+
+  lockTable( table );
+  GameState *state = table->slots + id;
+
+  // lockGame fails if the session already ended
+  if( !lockGame( state ) ) {
+    pthread_mutex_unlock( &table->lock );
+    return false;
+  }
+
+  state->inUse = false;
+  pthread_mutex_unlock( &state->lock );
+
+  // put the slot back on the free list so the next session can reuse it
+  state->nextFree = table->freeHead;
+  table->freeHead = id;
+  table->used--;
+
+  // anyone still attached can't start a session in a segment that's going away
+  if( removeIfLast && table->used == 0 && table->shmId != -1 ) {
+    table->magic = 0;
+    shmctl( table->shmId, IPC_RMID, 0 );
+  }
+
+  pthread_mutex_unlock( &table->lock );
+  return true;
+}
+
+GameState *findSession( SessionTable *table, int id ) {
+  if( id < 0 || id >= table->capacity || !table->slots[ id ].inUse ) {
+    return NULL;
+  }
+
+  return table->slots + id;
+}
@@ -0,0 +1,138 @@
+/**
+  * @file sessionbench.c
+  * @author Jake Donovan (jmpatte8)
+  * Benchmark for the session table. Times creating a segment with room for many sessions, filling it with new
+  * sessions, and then ending and starting sessions again so every slot comes from the free list. Uses its own
+  * key so it doesn't disturb a game reset made in the same directory. Compile with session.c.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include "common.h"
+
+// Number of sessions to create when we aren't told otherwise.
+#define DEFAULT_COUNT 10000
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+  fprintf( stderr, "%s\n", message );
+  exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+  fprintf( stderr, "usage: sessionbench [<sessions> [<board-size>]]\n" );
+  exit( 1 );
+}
+
+/**
+  * Seconds elapsed since the given time.
+  * @param start the starting time
+  * @return elapsed seconds
+*/
+static double elapsed( struct timespec *start ) {
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return ( now.tv_sec - start->tv_sec ) + ( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
+
+/**
+  * Print one line of results.
+  * @param label what was timed
+  * @param seconds how long it took
+  * @param count how many operations were timed
+*/
+static void report( char const *label, double seconds, int count ) {
+  printf( "%-28s %10.3f ms %10.0f ns/session\n", label, seconds * 1e3, seconds * 1e9 / count );
+}
+
+/**
+  * Program starting point. Runs each part of the benchmark and prints the results.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+  int count = DEFAULT_COUNT;
+  int size = 5;
+  if( argc > 3 || ( argc > 1 && ( sscanf( argv[ 1 ], "%d", &count ) != 1 || count < 1 ) ) ||
+      ( argc > 2 && ( sscanf( argv[ 2 ], "%d", &size ) != 1 || size < 1 || size > MAX_GRID_SIZE ) ) ) {
+    usage();
+  }
+
+  key_t key = ftok( ".", 2 );
+  if( key == -1 ) {
+    fail( "Key could not be created using ftok" );
+  }
+
+  // a checkerboard, the contents don't matter for timing
+  uint64_t rows[ MAX_GRID_SIZE ];
+  for( int i = 0; i < size; i++ ) {
+    rows[ i ] = ( i % 2 ? 0xaaaaaaaaaaaaaaaaULL : 0x5555555555555555ULL ) & rowMask( size );
+  }
+
+  int *ids = ( int * )malloc( count * sizeof( int ) );
+  struct timespec start;
+
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  SessionTable *table = createTable( key, count );
+  if( !table ) {
+    fail( "Can't create shared memory" );
+  }
+  double createTime = elapsed( &start );
+
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for( int i = 0; i < count; i++ ) {
+    ids[ i ] = newSession( table, rows, size );
+    if( ids[ i ] == -1 ) {
+      fail( "Ran out of session slots" );
+    }
+  }
+  double firstTime = elapsed( &start );
+
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for( int i = 0; i < count; i++ ) {
+    if( !endSession( table, ids[ i ], false ) ) {
+      fail( "Couldn't end a session" );
+    }
+  }
+  double endTime = elapsed( &start );
+
+  // every slot now comes off the free list
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for( int i = 0; i < count; i++ ) {
+    ids[ i ] = newSession( table, rows, size );
+    if( ids[ i ] == -1 ) {
+      fail( "Ran out of session slots" );
+    }
+  }
+  double reuseTime = elapsed( &start );
+
+  // end one session and start another, like games finishing and starting while the table is full
+  clock_gettime( CLOCK_MONOTONIC, &start );
+  for( int i = 0; i < count; i++ ) {
+    int slot = ( int )( ( long ) i * 7919 % count );
+    endSession( table, ids[ slot ], false );
+    ids[ slot ] = newSession( table, rows, size );
+    if( ids[ slot ] == -1 ) {
+      fail( "Ran out of session slots" );
+    }
+  }
+  double churnTime = elapsed( &start );
+
+  printf( "sessions: %d  board: %dx%d  segment: %zu bytes\n", count, size, size, tableBytes( count ) );
+  report( "create segment", createTime, count );
+  report( "create sessions", firstTime, count );
+  report( "end sessions", endTime, count );
+  report( "create from free list", reuseTime, count );
+  report( "end + create (full table)", churnTime, count );
+  report( "segment + sessions total", createTime + firstTime, count );
+
+  detachTable( table, true );
+  free( ids );
+  return 0;
+}
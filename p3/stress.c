@@ -0,0 +1,253 @@
+/**
+  * @file stress.c
+  * @author Jake Donovan (jmpatte8)
+  * Multi-process stress test for the shared lightsout board. Writer processes run "lightsout test" against
+  * the segment made by reset while reader processes take lock-free snapshots of the board. We report how
+  * many moves and snapshots per second we got and check that no reader ever saw a half finished move and
+  * that the final board matches the moves that were made. Compile with session.c.
+*/
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/shm.h>
+#include <errno.h>
+#include <string.h>
+#include "common.h"
+
+// Number of different cells the writers press. Keeping this small keeps the set of boards a
+// reader can legally see small, so a torn snapshot is very unlikely to look legal by accident.
+#define PRESS_CELLS 4
+
+// Cells the writers press, writer i presses pressList[ i % PRESS_CELLS ]. Filled in once we
+// know how big the board is.
+static int pressList[ PRESS_CELLS ][ 2 ];
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+  fprintf( stderr, "%s\n", message );
+  exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+  fprintf( stderr, "usage: stress <session> <writers> <readers> <moves-per-writer>\n" );
+  exit( 1 );
+}
+
+/**
+  * Check whether a snapshot is the starting board with some combination of the writers' moves applied.
+  * Moves commute, so every legal board is the start board with a subset of the cells pressed once.
+  * @param start rows of the starting board
+  * @param seen rows of the snapshot
+  * @param size height and width of the board
+  * @param cells number of distinct cells being pressed
+  * @return true if the snapshot is a legal board
+*/
+static bool legalBoard( uint64_t *start, uint64_t *seen, int size, int cells ) {
+  uint64_t board[ MAX_GRID_SIZE ];
+  for( int subset = 0; subset < ( 1 << cells ); subset++ ) {
+    memcpy( board, start, size * sizeof( uint64_t ) );
+    for( int i = 0; i < cells; i++ ) {
+      if( subset & ( 1 << i ) ) {
+        pressCell( board, size, pressList[ i ][ 0 ], pressList[ i ][ 1 ] );
+      }
+    }
+
+    if( memcmp( board, seen, size * sizeof( uint64_t ) ) == 0 ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/** Set by the parent with SIGTERM when the writers are done. */
+static volatile sig_atomic_t stopReading = 0;
+
+/** Signal handler telling a reader to finish. */
+static void stopHandler( int sig ) {
+  ( void ) sig;
+  stopReading = 1;
+}
+
+/**
+  * Body of a reader process. Reads snapshots until told to stop, then writes the number of
+  * snapshots and the number of illegal snapshots to the given pipe.
+  * @param state the attached game state
+  * @param start rows of the starting board
+  * @param cells number of distinct cells being pressed
+  * @param fd write end of the result pipe
+*/
+static void reader( GameState *state, uint64_t *start, int cells, int fd ) {
+  long counts[ 2 ] = { 0, 0 };
+  uint64_t board[ MAX_GRID_SIZE ];
+
+  while( !stopReading ) {
+    readBoard( state, board );
+    if( !legalBoard( start, board, state->size, cells ) ) {
+      counts[ 1 ]++;
+    }
+    counts[ 0 ]++;
+  }
+
+  write( fd, counts, sizeof( counts ) );
+  exit( 0 );
+}
+
+/**
+  * Seconds elapsed since the given time.
+  * @param start the starting time
+  * @return elapsed seconds
+*/
+static double elapsed( struct timespec *start ) {
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return ( now.tv_sec - start->tv_sec ) + ( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
+
+/**
+  * Program starting point. Runs the writer and reader processes against the current board
+  * and reports throughput and consistency.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status, 1 if an inconsistency was found
+*/
+int main( int argc, char *argv[] ) {
+  int id, writers, readers, moves;
+  if( argc != 5 || sscanf( argv[ 1 ], "%d", &id ) != 1 || sscanf( argv[ 2 ], "%d", &writers ) != 1 ||
+      sscanf( argv[ 3 ], "%d", &readers ) != 1 || sscanf( argv[ 4 ], "%d", &moves ) != 1 ||
+      writers < 1 || readers < 0 || moves < 1 ) {
+    usage();
+  }
+
+  SessionTable *table = attachTable( ftok( ".", 1 ) );
+  if( !table ) {
+    fail( "Can't find the sessions, run reset first" );
+  }
+
+  GameState *state = findSession( table, id );
+  if( !state || state->size < 2 ) {
+    fail( "Session isn't usable" );
+  }
+
+  // corners and the middle, spread out so the presses overlap as little as possible
+  int size = state->size;
+  int cellList[ PRESS_CELLS ][ 2 ] = { { 0, 0 }, { size / 2, size / 2 }, { size - 1, 1 }, { 1, size - 1 } };
+  memcpy( pressList, cellList, sizeof( pressList ) );
+
+  uint64_t start[ MAX_GRID_SIZE ];
+  readBoard( state, start );
+
+  int cells = writers < PRESS_CELLS ? writers : PRESS_CELLS;
+
+  int pfd[ 2 ];
+  if( pipe( pfd ) != 0 ) {
+    fail( "Can't create pipe" );
+  }
+
+  // start the readers first so they're running the whole time the writers are. The handler
+  // is installed before forking so a reader can't miss the stop signal.
+  signal( SIGTERM, stopHandler );
+  pid_t *readerIds = ( pid_t * )malloc( sizeof( pid_t ) * ( readers + 1 ) );
+  for( int i = 0; i < readers; i++ ) {
+    readerIds[ i ] = fork();
+    if( readerIds[ i ] == -1 ) {
+      fail( "Can't create reader process" );
+    }
+
+    if( readerIds[ i ] == 0 ) {
+      close( pfd[ 0 ] );
+      reader( state, start, cells, pfd[ 1 ] );
+    }
+  }
+
+  struct timespec begin;
+  clock_gettime( CLOCK_MONOTONIC, &begin );
+
+  char session[ 20 ], count[ 20 ];
+  snprintf( session, sizeof( session ), "%d", id );
+  snprintf( count, sizeof( count ), "%d", moves );
+  for( int i = 0; i < writers; i++ ) {
+    pid_t pid = fork();
+    if( pid == -1 ) {
+      fail( "Can't create writer process" );
+    }
+
+    if( pid == 0 ) {
+      char row[ 20 ], col[ 20 ];
+      snprintf( row, sizeof( row ), "%d", pressList[ i % PRESS_CELLS ][ 0 ] );
+      snprintf( col, sizeof( col ), "%d", pressList[ i % PRESS_CELLS ][ 1 ] );
+      // lightsout prints success, we only want the numbers
+      int devNull = open( "/dev/null", O_WRONLY );
+      dup2( devNull, STDOUT_FILENO );
+      execl( "./lightsout", "lightsout", session, "test", count, row, col, ( char * )NULL );
+      fail( "Can't run ./lightsout" );
+    }
+  }
+
+  // wait for the writers, every pid that isn't a reader is one of ours
+  bool writersOk = true;
+  for( int done = 0; done < writers; ) {
+    int status;
+    pid_t pid = wait( &status );
+    bool isReader = false;
+    for( int i = 0; i < readers; i++ ) {
+      isReader |= ( pid == readerIds[ i ] );
+    }
+
+    if( !isReader ) {
+      writersOk &= WIFEXITED( status ) && WEXITSTATUS( status ) == 0;
+      done++;
+    }
+  }
+
+  double seconds = elapsed( &begin );
+
+  // stop the readers and collect what they saw
+  long snapshots = 0;
+  long torn = 0;
+  for( int i = 0; i < readers; i++ ) {
+    kill( readerIds[ i ], SIGTERM );
+  }
+
+  close( pfd[ 1 ] );
+  for( int i = 0; i < readers; i++ ) {
+    long counts[ 2 ];
+    if( read( pfd[ 0 ], counts, sizeof( counts ) ) == sizeof( counts ) ) {
+      snapshots += counts[ 0 ];
+      torn += counts[ 1 ];
+    }
+    waitpid( readerIds[ i ], NULL, 0 );
+  }
+
+  // moves commute, so the final board only depends on how many times each cell was pressed
+  uint64_t expected[ MAX_GRID_SIZE ];
+  memcpy( expected, start, size * sizeof( uint64_t ) );
+  for( int i = 0; i < writers; i++ ) {
+    if( moves % 2 == 1 ) {
+      pressCell( expected, size, pressList[ i % PRESS_CELLS ][ 0 ], pressList[ i % PRESS_CELLS ][ 1 ] );
+    }
+  }
+
+  uint64_t board[ MAX_GRID_SIZE ];
+  readBoard( state, board );
+  bool finalOk = memcmp( board, expected, size * sizeof( uint64_t ) ) == 0;
+
+  printf( "board: %dx%d  writers: %d  readers: %d  moves per writer: %d\n", size, size, writers, readers, moves );
+  printf( "elapsed: %.3f s\n", seconds );
+  printf( "moves/sec: %.0f\n", ( double ) writers * moves / seconds );
+  printf( "snapshots/sec: %.0f\n", snapshots / seconds );
+  printf( "torn snapshots: %ld of %ld\n", torn, snapshots );
+  printf( "final board: %s\n", finalOk ? "consistent" : "INCONSISTENT" );
+
+  free( readerIds );
+  detachTable( table, false );
+  return writersOk && finalOk && torn == 0 ? 0 : 1;
+}
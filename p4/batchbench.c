@@ -0,0 +1,210 @@
+/**
+  * @file batchbench.c
+  * @author Jake Donovan (jmpatte8)
+  * Benchmark for the hall monitor's batch calls. A number of threads each keep placing a batch of organizations of
+  * random widths and freeing them again, for a fixed time, first with one allocateSpace and freeSpace call per
+  * organization and then with allocateBatch and freeBatch. We report allocations per second, how many times the
+  * monitor's lock was taken per allocation and how often it was contended, and how many allocations had to wait. The
+  * monitor logs to /dev/null through its event log so printing stays out of the timings. Compile with hall.c and
+  * eventlog.c.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "hall.h"
+
+// Threads, organizations in each batch and seconds for each way when we aren't told otherwise.
+#define DEFAULT_THREADS 8
+#define DEFAULT_BATCH 32
+#define DEFAULT_SECONDS 2
+
+// Widest organization, widths go from 1 up to this.
+#define MAX_WIDTH 8
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+    fprintf( stderr, "%s\n", message );
+    exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+    fprintf( stderr, "usage: batchbench [<threads> [<batch-size> [<seconds>]]]\n" );
+    exit( 1 );
+}
+
+/** One thread and what it did */
+typedef struct {
+    // its batch, names and widths are filled in once
+    SpaceRequest *batch;
+    char ( *names )[ 16 ];
+    // allocations it made
+    long allocations;
+} Caller;
+
+/** Organizations in each batch */
+static int batchSize;
+
+/** True to use allocateBatch and freeBatch, false for a call per organization */
+static bool batched;
+
+/** Set to tell the threads to stop */
+static atomic_bool stop;
+
+/**
+  * Current time in nanoseconds.
+  * @return monotonic clock reading
+*/
+static long long nanoTime() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+  * Start routine for each thread, placing and freeing its batch until told to stop.
+  * @param arg the thread's Caller
+*/
+static void *caller( void *arg ) {
+    Caller *c = ( Caller * )arg;
+    while( !atomic_load( &stop ) ) {
+        if( batched ) {
+            allocateBatch( c->batch, batchSize );
+            freeBatch( c->batch, batchSize );
+        }
+
+        else {
+            for( int i = 0; i < batchSize; i++ ) {
+                c->batch[ i ].start = allocateSpace( c->batch[ i ].name, c->batch[ i ].width );
+            }
+
+            for( int i = 0; i < batchSize; i++ ) {
+                freeSpace( c->batch[ i ].name, c->batch[ i ].start, c->batch[ i ].width );
+            }
+        }
+
+        c->allocations += batchSize;
+    }
+
+    return NULL;
+}
+
+/**
+  * Run every thread one way for a while and print what we and the monitor counted.
+  * @param label name of the way
+  * @param callers the threads
+  * @param threads number of threads
+  * @param size spaces in the hall
+  * @param seconds how long to run
+  * @param saved the real standard output, where the results go
+*/
+static void run( char const *label, Caller *callers, int threads, int size, int seconds, int saved ) {
+    pthread_t *thread = ( pthread_t * )malloc( threads * sizeof( pthread_t ) );
+    initMonitor( size );
+    setLogMode( LOG_DIFF );
+    atomic_store( &stop, false );
+
+    long long start = nanoTime();
+    for( int i = 0; i < threads; i++ ) {
+        callers[ i ].allocations = 0;
+        if( pthread_create( &thread[ i ], NULL, caller, &callers[ i ] ) != 0 ) {
+            fail( "Can't create thread" );
+        }
+    }
+
+    sleep( seconds );
+    atomic_store( &stop, true );
+    for( int i = 0; i < threads; i++ ) {
+        pthread_join( thread[ i ], NULL );
+    }
+    double elapsed = ( nanoTime() - start ) / 1e9;
+
+    MonitorStats stats;
+    getMonitorStats( &stats );
+    destroyMonitor();
+    fflush( stdout );
+
+    long allocations = 0;
+    for( int i = 0; i < threads; i++ ) {
+        allocations += callers[ i ].allocations;
+    }
+
+    dprintf( saved, "%-9s %12.0f %14.3f %12.1f %12.1f\n", label, allocations / elapsed,
+             ( double ) stats.lockHolds / allocations, 100.0 * stats.contended / stats.lockHolds,
+             100.0 * stats.waits / allocations );
+    free( thread );
+}
+
+/**
+  * Program starting point. Runs the same batches one call at a time and then as batches.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    int threads = DEFAULT_THREADS;
+    int seconds = DEFAULT_SECONDS;
+    batchSize = DEFAULT_BATCH;
+    if( argc > 4 || ( argc > 1 && ( sscanf( argv[ 1 ], "%d", &threads ) != 1 || threads < 1 ) ) ||
+        ( argc > 2 && ( sscanf( argv[ 2 ], "%d", &batchSize ) != 1 || batchSize < 1 ) ) ||
+        ( argc > 3 && ( sscanf( argv[ 3 ], "%d", &seconds ) != 1 || seconds < 1 ) ) ) {
+        usage();
+    }
+
+    // room for everyone's batches at once, when a call is made for each organization a thread holds part of its batch
+    // while it waits for the rest, and could otherwise wait forever on another doing the same, batches can't
+    int size = threads * batchSize * MAX_WIDTH;
+
+    Caller *callers = ( Caller * )calloc( threads, sizeof( Caller ) );
+    if( !callers ) {
+        fail( "Out of memory" );
+    }
+
+    srand( 1 );
+    for( int i = 0; i < threads; i++ ) {
+        callers[ i ].batch = ( SpaceRequest * )malloc( batchSize * sizeof( SpaceRequest ) );
+        callers[ i ].names = ( char ( * )[ 16 ] )malloc( batchSize * 16 );
+        if( !callers[ i ].batch || !callers[ i ].names ) {
+            fail( "Out of memory" );
+        }
+
+        for( int j = 0; j < batchSize; j++ ) {
+            snprintf( callers[ i ].names[ j ], 16, "%c%d", 'A' + i % 26, j );
+            callers[ i ].batch[ j ].name = callers[ i ].names[ j ];
+            callers[ i ].batch[ j ].width = 1 + rand() % MAX_WIDTH;
+        }
+    }
+
+    // keep the monitor's messages out of the results
+    fflush( stdout );
+    int saved = dup( STDOUT_FILENO );
+    int devNull = open( "/dev/null", O_WRONLY );
+    if( saved == -1 || devNull == -1 ) {
+        fail( "Can't redirect output" );
+    }
+    dup2( devNull, STDOUT_FILENO );
+    close( devNull );
+
+    dprintf( saved, "threads: %d  batch: %d  widths: 1-%d  hall: %d spaces  seconds each: %d\n", threads, batchSize,
+             MAX_WIDTH, size, seconds );
+    dprintf( saved, "%-9s %12s %14s %12s %12s\n", "calls", "allocs/s", "locks/alloc", "contended %", "waited %" );
+    batched = false;
+    run( "separate", callers, threads, size, seconds, saved );
+    batched = true;
+    run( "batch", callers, threads, size, seconds, saved );
+
+    dup2( saved, STDOUT_FILENO );
+    close( saved );
+    for( int i = 0; i < threads; i++ ) {
+        free( callers[ i ].batch );
+        free( callers[ i ].names );
+    }
+    free( callers );
+    return 0;
+}
@@ -0,0 +1,478 @@
+/**
+  * @file eventlog.c
+  * @author Jake Donovan (jmpatte8)
+  * This file is responsible for the hall's event log. Every thread that records an event gets its own ring of events,
+  * which only it writes and only the logger thread reads, so recording is a copy and an atomic store. Each event gets
+  * a sequence number when it is recorded, and the logger prints them in that order, keeping its own copy of the hall
+  * up to date so it can print the hall the way the monitor would have. A thread's ring is kept for the next log when
+  * one stops, and when the thread exits the logger frees it once everything in it is printed. Nobody waits for room
+  * in a ring while holding the monitor's lock, threads wait in waitForLogRoom before they take it, and an event that
+  * still doesn't fit goes on the ring's overflow list instead. Events are never dropped, a lost allocation or free
+  * would leave the logger's copy of the hall wrong from then on.
+*/
+
+#include "eventlog.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// Number of events each thread's ring can hold, must be a power of two.
+#define EVENT_SLOTS 1024
+
+// Most characters of an organization's name we keep.
+#define NAME_LIMIT 32
+
+// Nanoseconds the logger sleeps when it has nothing to print.
+#define IDLE_NS 1000000
+
+// Most events a thread's ring can hold when it takes the monitor's lock, the rest is room for what it records there.
+#define ROOM_SLOTS ( EVENT_SLOTS / 2 )
+
+/** One recorded event */
+typedef struct {
+    // order it was recorded in
+    long seq;
+    // EVENT_WAIT, EVENT_ALLOCATE, EVENT_FREE, EVENT_CANCEL or EVENT_MOVE
+    int type;
+    // leftmost space and number of spaces, and for a move, the leftmost space before it
+    int start;
+    int width;
+    int from;
+    // for a rectangle in a grid, its top row and number of rows, and start is its leftmost column, height is 0 in a hall
+    int row;
+    int height;
+    // name of the organization
+    char name[ NAME_LIMIT ];
+} Event;
+
+/** An event that didn't fit in its thread's ring */
+typedef struct SpillStruct {
+    // the event
+    Event event;
+    // next event in the list, set by the owning thread once this one is filled in
+    struct SpillStruct *_Atomic next;
+} Spill;
+
+/** One thread's events, written by that thread and read by the logger */
+typedef struct EventRingStruct {
+    // number of events ever recorded, only the owning thread changes it
+    _Atomic unsigned head;
+    // number of events ever printed, only the logger changes it
+    _Atomic unsigned tail;
+    // the events
+    Event event[ EVENT_SLOTS ];
+    // events that didn't fit, in order. The list always starts with a used up node the logger frees when it moves
+    // past it, so the logger only changes spill and the owning thread only changes lastSpill
+    Spill *spill;
+    Spill *lastSpill;
+    // the node nextEvent handed out for an event that didn't fit, NULL if it handed out a slot in the ring
+    Spill *filling;
+    // the log it's in, since a thread can outlive a log, only the owning thread changes it, under ringLock
+    long generation;
+    // set under ringLock once the owning thread has exited, the logger frees it when it's empty
+    bool retired;
+    // ring of another thread, only changed under ringLock
+    struct EventRingStruct *nextRing;
+} EventRing;
+
+/** Every thread's ring in this log, newest first */
+static EventRing *_Atomic rings;
+
+/** The calling thread's ring */
+static __thread EventRing *myRing;
+
+/** Which log this is, changes every time one starts or stops */
+static atomic_long generation;
+
+/** Lock for adding, retiring and freeing rings, and for waiting for room in one */
+static pthread_mutex_t ringLock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Signaled when the logger makes room while someone is waiting for it, and how many are */
+static pthread_cond_t roomCond = PTHREAD_COND_INITIALIZER;
+static atomic_int roomWaiters;
+
+/** Key whose destructor retires a thread's ring when it exits */
+static pthread_key_t ringKey;
+static pthread_once_t ringKeyOnce = PTHREAD_ONCE_INIT;
+
+/** Events dropped because there was no memory to keep them in */
+static atomic_long dropped;
+
+/** Sequence number for the next event */
+static long nextSeq;
+
+/** The logger's copy of the hall */
+static char *view;
+
+/** True to print only what changed */
+static bool diffMode;
+
+/** The logger thread, and the flag that tells it to finish */
+static pthread_t logger;
+static atomic_bool stopping;
+
+/**
+  * Format one event, bringing our copy of the hall up to date first.
+  * @param event the event
+*/
+static void printEvent( Event *event ) {
+    static char const *const label[] = { "waiting", "allocated", "freed", "gave up", "moved" };
+
+    // a grid has no hall for us to keep a copy of
+    if( event->height > 0 ) {
+        if( event->type == EVENT_WAIT ) {
+            printf( "%s %s: %dx%d\n", event->name, label[ event->type ], event->width, event->height );
+        }
+
+        else {
+            printf( "%s %s: %dx%d at %d,%d\n", event->name, label[ event->type ], event->width, event->height,
+                    event->row, event->start );
+        }
+        return;
+    }
+
+    bool changed = event->type == EVENT_ALLOCATE || event->type == EVENT_FREE || event->type == EVENT_MOVE;
+
+    // a move clears where it was first, the two can overlap
+    if( event->type == EVENT_MOVE ) {
+        memset( view + event->from, '*', event->width );
+    }
+
+    if( changed ) {
+        memset( view + event->start, event->type == EVENT_FREE ? '*' : event->name[ 0 ], event->width );
+    }
+
+    if( !diffMode ) {
+        printf( "%s %s: %s\n", event->name, label[ event->type ], view );
+    }
+
+    else if( !changed ) {
+        printf( "%s %s: %d\n", event->name, label[ event->type ], event->width );
+    }
+
+    else if( event->type == EVENT_MOVE ) {
+        printf( "%s %s: %d to %d %.*s\n", event->name, label[ event->type ], event->from, event->start,
+                event->width, view + event->start );
+    }
+
+    else {
+        printf( "%s %s: %d %.*s\n", event->name, label[ event->type ], event->start, event->width,
+                view + event->start );
+    }
+}
+
+/**
+  * Number of events in a ring the logger hasn't printed yet.
+  * @param ring a ring
+  * @return number of events
+*/
+static unsigned ringUsed( EventRing *ring ) {
+    return atomic_load_explicit( &ring->head, memory_order_relaxed ) -
+           atomic_load_explicit( &ring->tail, memory_order_acquire );
+}
+
+/**
+  * Free a ring and what's left of its overflow list.
+  * @param ring a ring
+*/
+static void freeRing( EventRing *ring ) {
+    while( ring->spill ) {
+        Spill *next = atomic_load( &ring->spill->next );
+        free( ring->spill );
+        ring->spill = next;
+    }
+    free( ring );
+}
+
+/**
+  * Destructor for ringKey, runs when a thread that recorded events exits. Its ring stays in the log until the logger
+  * has printed it, and one no longer in a log is freed right away.
+  * @param arg the thread's ring
+*/
+static void retireRing( void *arg ) {
+    EventRing *ring = ( EventRing * )arg;
+    pthread_mutex_lock( &ringLock );
+    if( ring->generation == atomic_load( &generation ) ) {
+        ring->retired = true;
+    }
+
+    else {
+        freeRing( ring );
+    }
+    pthread_mutex_unlock( &ringLock );
+}
+
+/** Create ringKey, once. */
+static void makeRingKey() {
+    pthread_key_create( &ringKey, retireRing );
+}
+
+/** Free the rings of threads that have exited, once everything in them is printed. Only the logger calls this. */
+static void reclaimRings() {
+    pthread_mutex_lock( &ringLock );
+    EventRing *prev = NULL;
+    EventRing *ring = atomic_load( &rings );
+    while( ring ) {
+        EventRing *next = ring->nextRing;
+        if( ring->retired && ringUsed( ring ) == 0 && !atomic_load( &ring->spill->next ) ) {
+            if( prev ) {
+                prev->nextRing = next;
+            }
+
+            else {
+                atomic_store( &rings, next );
+            }
+            freeRing( ring );
+        }
+
+        else {
+            prev = ring;
+        }
+        ring = next;
+    }
+    pthread_mutex_unlock( &ringLock );
+}
+
+/**
+  * Start routine for the logger. Looks through every ring for the next event in order, and sleeps a little
+  * when nobody has recorded it yet.
+  * @param arg not used
+*/
+static void *logEvents( void *arg ) {
+    ( void )arg;
+    long seq = 0;
+    while( true ) {
+        // read before looking at the rings, every event was recorded before we were told to finish
+        bool finishing = atomic_load( &stopping );
+        bool found = false;
+        bool pending = false;
+        for( EventRing *ring = atomic_load( &rings ); ring; ring = ring->nextRing ) {
+            unsigned tail = atomic_load_explicit( &ring->tail, memory_order_relaxed );
+            unsigned head = atomic_load_explicit( &ring->head, memory_order_acquire );
+
+            // events are recorded in order, so the next event in a ring, or in its overflow list, is only ever the
+            // one we need or a later one
+            while( true ) {
+                Spill *spill = atomic_load_explicit( &ring->spill->next, memory_order_acquire );
+                if( tail != head && ring->event[ tail % EVENT_SLOTS ].seq == seq ) {
+                    printEvent( &ring->event[ tail % EVENT_SLOTS ] );
+                    atomic_store_explicit( &ring->tail, ++tail, memory_order_release );
+                }
+
+                else if( spill && spill->event.seq == seq ) {
+                    printEvent( &spill->event );
+                    free( ring->spill );
+                    ring->spill = spill;
+                }
+
+                else {
+                    pending |= tail != head || spill;
+                    break;
+                }
+
+                seq++;
+                found = true;
+            }
+        }
+
+        // wake anyone waiting for room, the fence orders our tail stores before reading the count
+        if( found ) {
+            atomic_thread_fence( memory_order_seq_cst );
+            if( atomic_load( &roomWaiters ) > 0 ) {
+                pthread_mutex_lock( &ringLock );
+                pthread_cond_broadcast( &roomCond );
+                pthread_mutex_unlock( &ringLock );
+            }
+        }
+
+        else {
+            // nothing left anywhere and we've been told to finish
+            if( !pending && finishing ) {
+                break;
+            }
+
+            reclaimRings();
+            fflush( stdout );
+            struct timespec idle = { 0, IDLE_NS };
+            nanosleep( &idle, NULL );
+        }
+    }
+
+    fflush( stdout );
+    return NULL;
+}
+
+void startEventLog( char const *hall, bool diff ) {
+    pthread_once( &ringKeyOnce, makeRingKey );
+    view = strdup( hall );
+    diffMode = diff;
+
+    pthread_mutex_lock( &ringLock );
+    atomic_fetch_add( &generation, 1 );
+    nextSeq = 0;
+    atomic_store( &rings, NULL );
+    atomic_store( &dropped, 0 );
+    pthread_mutex_unlock( &ringLock );
+    atomic_store( &stopping, false );
+    pthread_create( &logger, NULL, logEvents, NULL );
+}
+
+void waitForLogRoom() {
+    // no log, or a ring from a log that has stopped, which the next event empties
+    EventRing *ring = myRing;
+    if( !ring || ring->generation != atomic_load( &generation ) || ringUsed( ring ) <= ROOM_SLOTS ) {
+        return;
+    }
+
+    pthread_mutex_lock( &ringLock );
+    atomic_fetch_add( &roomWaiters, 1 );
+    atomic_thread_fence( memory_order_seq_cst );
+    while( ring->generation == atomic_load( &generation ) && ringUsed( ring ) > ROOM_SLOTS ) {
+        pthread_cond_wait( &roomCond, &ringLock );
+    }
+    atomic_fetch_sub( &roomWaiters, 1 );
+    pthread_mutex_unlock( &ringLock );
+}
+
+/**
+  * Find the slot for the calling thread's next event, giving it a ring in this log first if it doesn't have one.
+  * @return the slot, publish it with publishEvent, or NULL if we're out of memory
+*/
+static Event *nextEvent() {
+    // first event from this thread in this log, give it a ring the logger can find, its old one if it has one
+    if( !myRing || myRing->generation != atomic_load( &generation ) ) {
+        pthread_mutex_lock( &ringLock );
+        if( !myRing ) {
+            EventRing *ring = ( EventRing * )malloc( sizeof( EventRing ) );
+            Spill *spill = ( Spill * )malloc( sizeof( Spill ) );
+            if( !ring || !spill ) {
+                pthread_mutex_unlock( &ringLock );
+                free( ring );
+                free( spill );
+                atomic_fetch_add( &dropped, 1 );
+                return NULL;
+            }
+
+            // the overflow list starts with just its used up node, a stopped log leaves it that way for the next
+            atomic_init( &spill->next, NULL );
+            ring->spill = ring->lastSpill = spill;
+            myRing = ring;
+            pthread_setspecific( ringKey, myRing );
+        }
+        atomic_init( &myRing->head, 0 );
+        atomic_init( &myRing->tail, 0 );
+        myRing->generation = atomic_load( &generation );
+        myRing->retired = false;
+        myRing->nextRing = atomic_load( &rings );
+        atomic_store( &rings, myRing );
+        pthread_mutex_unlock( &ringLock );
+    }
+
+    // full, we may be holding the monitor's lock so we don't wait for the logger, the event goes on the overflow list
+    Event *event;
+    unsigned head = atomic_load_explicit( &myRing->head, memory_order_relaxed );
+    if( head - atomic_load_explicit( &myRing->tail, memory_order_acquire ) == EVENT_SLOTS ) {
+        Spill *spill = ( Spill * )malloc( sizeof( Spill ) );
+        if( !spill ) {
+            atomic_fetch_add( &dropped, 1 );
+            return NULL;
+        }
+        atomic_init( &spill->next, NULL );
+        myRing->filling = spill;
+        event = &spill->event;
+    }
+
+    else {
+        myRing->filling = NULL;
+        event = &myRing->event[ head % EVENT_SLOTS ];
+    }
+
+    event->seq = nextSeq++;
+    return event;
+}
+
+/**
+  * Let the logger see the event from nextEvent.
+  * @param event the event, with everything filled in but its name
+  * @param name name of the organization
+*/
+static void publishEvent( Event *event, char const *name ) {
+    strncpy( event->name, name, NAME_LIMIT - 1 );
+    event->name[ NAME_LIMIT - 1 ] = '\0';
+
+    // an event from the overflow list goes on the end of it
+    if( myRing->filling ) {
+        atomic_store_explicit( &myRing->lastSpill->next, myRing->filling, memory_order_release );
+        myRing->lastSpill = myRing->filling;
+        return;
+    }
+
+    unsigned head = atomic_load_explicit( &myRing->head, memory_order_relaxed );
+    atomic_store_explicit( &myRing->head, head + 1, memory_order_release );
+}
+
+void logEvent( int type, char const *name, int start, int width ) {
+    Event *event = nextEvent();
+    if( !event ) {
+        return;
+    }
+    event->type = type;
+    event->start = start;
+    event->width = width;
+    event->height = 0;
+    publishEvent( event, name );
+}
+
+void logRect( int type, char const *name, int row, int col, int width, int height ) {
+    Event *event = nextEvent();
+    if( !event ) {
+        return;
+    }
+    event->type = type;
+    event->row = row;
+    event->start = col;
+    event->width = width;
+    event->height = height;
+    publishEvent( event, name );
+}
+
+void logMove( char const *name, int from, int to, int width ) {
+    Event *event = nextEvent();
+    if( !event ) {
+        return;
+    }
+    event->type = EVENT_MOVE;
+    event->start = to;
+    event->width = width;
+    event->from = from;
+    event->height = 0;
+    publishEvent( event, name );
+}
+
+void stopEventLog() {
+    atomic_store( &stopping, true );
+    pthread_join( logger, NULL );
+
+    // rings of threads still running are theirs to use in the next log, or to free when they exit
+    pthread_mutex_lock( &ringLock );
+    EventRing *ring = atomic_load( &rings );
+    while( ring ) {
+        EventRing *next = ring->nextRing;
+        if( ring->retired ) {
+            freeRing( ring );
+        }
+        ring = next;
+    }
+    atomic_store( &rings, NULL );
+    atomic_fetch_add( &generation, 1 );
+    pthread_cond_broadcast( &roomCond );
+    pthread_mutex_unlock( &ringLock );
+
+    if( atomic_load( &dropped ) > 0 ) {
+        fprintf( stderr, "event log: %ld events dropped, out of memory\n", atomic_load( &dropped ) );
+    }
+    free( view );
+}
@@ -0,0 +1,67 @@
+/**
+  * @file eventlog.h
+  * @author Jake Donovan (jmpatte8)
+  * Header for the hall's event log, which lets the monitor record what it did without doing any output while it
+  * holds its lock. A background thread formats the events. The grid monitor uses it the same way.
+*/
+
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdbool.h>
+
+// Kinds of event.
+#define EVENT_WAIT 0
+#define EVENT_ALLOCATE 1
+#define EVENT_FREE 2
+#define EVENT_CANCEL 3
+#define EVENT_MOVE 4
+
+/**
+  * Start the background thread that prints events.
+  * @param hall the hall as it is now, the log keeps its own copy up to date from the events
+  * @param diff true to print only the spaces each event changed, false to print the whole hall
+*/
+void startEventLog( char const *hall, bool diff );
+
+/**
+  * Wait until the calling thread's ring has room for everything it might record while holding the monitor's lock.
+  * Call it before taking the lock, it never waits when there is no log.
+*/
+void waitForLogRoom();
+
+/**
+  * Record an event in the calling thread's ring. Calls must be serialized by the caller, the events are printed in
+  * the order they were recorded. If the ring is full the event goes on an overflow list, so it is never dropped.
+  * @param type EVENT_WAIT, EVENT_ALLOCATE, EVENT_FREE or EVENT_CANCEL
+  * @param name name of the organization
+  * @param start leftmost space the event is about
+  * @param width number of spaces
+*/
+void logEvent( int type, char const *name, int start, int width );
+
+/**
+  * Record that the monitor moved an organization's spaces, as an EVENT_MOVE. Calls are serialized with logEvent.
+  * @param name name of the organization
+  * @param from leftmost space it had
+  * @param to leftmost space it has now
+  * @param width number of spaces
+*/
+void logMove( char const *name, int from, int to, int width );
+
+/**
+  * Record an event about a rectangle of spaces in a grid, calls are serialized with logEvent. Use it only in a log
+  * started with an empty hall, rectangles don't change the logger's copy of it.
+  * @param type EVENT_WAIT, EVENT_ALLOCATE or EVENT_FREE
+  * @param name name of the organization
+  * @param row top row, ignored for EVENT_WAIT
+  * @param col leftmost column, ignored for EVENT_WAIT
+  * @param width number of columns
+  * @param height number of rows, at least 1
+*/
+void logRect( int type, char const *name, int row, int col, int width, int height );
+
+/** Print every event still waiting to be printed, then stop the background thread. */
+void stopEventLog();
+
+#endif
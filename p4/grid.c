@@ -0,0 +1,438 @@
+/**
+  * @file grid.c
+  * @author Jake Donovan (jmpatte8)
+  * Monitor for a hall laid out as a grid, handing out width by height rectangles of spaces to organizations. Each row
+  * is a bitmap with one bit per space, and we keep the longest free run in each row. A search for a rectangle only
+  * looks at windows of height rows that all have a run at least width long, skipping the rest, and ORs the rows in the
+  * window together a 64-bit word at a time to find the leftmost run of width columns free in all of them. The windows
+  * slide a row at a time, so rows are cut into blocks of height and each window is the end of one block ORed with the
+  * start of the next, both kept as we go, rather than ORing all its rows again. Waiting and freeing work like the hall
+  * monitor: organizations that have to wait each get their own condition variable, whoever frees space hands it
+  * straight to the waiters it now fits, oldest first, so only they are woken, and what happens goes to the event log
+  * so nothing is printed while we hold the lock. Compile with eventlog.c.
+*/
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "grid.h"
+#include "eventlog.h"
+
+// Spaces in each bitmap word.
+#define WORD_BITS 64
+
+/** Our mutex lock to prevent two organizations from accessing the monitor at a time */
+static pthread_mutex_t lock;
+
+/** Size of the grid */
+static int rows;
+static int cols;
+
+/** Words in each row's bitmap */
+static int rowWords;
+
+/** The grid, row after row, one bit per space, set if an organization is occupying it. Bit b of word w in a row is
+  * column 64w + b, and bits past the end of a row are kept set so no run can reach them
+*/
+static uint64_t * bitmap;
+
+/** Longest run of free spaces in each row */
+static int * longest;
+
+/** Room for ORing the rows of a window together */
+static uint64_t * window;
+
+/** While searching, the rows of the current block so far ORed together, and for each row of the block before, it and
+  * the rows after it in that block ORed together. The second has room for a block as tall as the grid
+*/
+static uint64_t * prefix;
+static uint64_t * suffix;
+
+/** An organization waiting for a rectangle, it lives on the waiting thread's stack */
+typedef struct WaiterStruct {
+    // name of the organization
+    char const *name;
+    // size of the rectangle it needs
+    int width;
+    int height;
+    // set once space has been handed to it, and the corner it was handed
+    bool granted;
+    int row;
+    int col;
+    // signaled only when this organization is handed space
+    pthread_cond_t cond;
+    // next waiter, in the order they arrived
+    struct WaiterStruct *next;
+} Waiter;
+
+/** Oldest and newest waiters */
+static Waiter * waiters;
+static Waiter * lastWaiter;
+
+/**
+  * Longest run of free spaces inside one word, not counting runs that reach either end.
+  * @param word the bitmap word, a set bit is an occupied space, at least one bit is set
+  * @return length of the longest run
+*/
+static int innerRun( uint64_t word ) {
+    // hop from one free run to the next, using ctz to measure each
+    uint64_t free = ~word;
+    int best = 0;
+    while( free ) {
+        free >>= __builtin_ctzll( free );
+        int length = __builtin_ctzll( ~free );
+        if( length > best ) {
+            best = length;
+        }
+        free >>= length;
+    }
+
+    return best;
+}
+
+/**
+  * Work out the longest run of free spaces in a row, from its bitmap.
+  * @param r the row
+  * @return length of the longest run
+*/
+static int rowRun( int r ) {
+    uint64_t *row = bitmap + ( long ) r * rowWords;
+    int best = 0;
+
+    // free spaces carried over from the end of the words before
+    int carry = 0;
+    for( int w = 0; w < rowWords; w++ ) {
+        if( row[ w ] == 0 ) {
+            carry += WORD_BITS;
+            continue;
+        }
+
+        int run = carry + __builtin_ctzll( row[ w ] );
+        if( run > best ) {
+            best = run;
+        }
+
+        run = innerRun( row[ w ] );
+        if( run > best ) {
+            best = run;
+        }
+
+        carry = __builtin_clzll( row[ w ] );
+    }
+
+    return carry > best ? carry : best;
+}
+
+/**
+  * Find the leftmost run of width spaces free in a bitmap row, a word at a time.
+  * @param row the row, a set bit is an occupied space
+  * @param width number of spaces needed
+  * @return column where the run starts, or -1 if there is none
+*/
+static int findRun( uint64_t const *row, int width ) {
+    int carry = 0;
+    for( int w = 0; w < rowWords; w++ ) {
+        uint64_t word = row[ w ];
+        int end = ( w + 1 ) * WORD_BITS;
+        if( word == 0 ) {
+            carry += WORD_BITS;
+            if( carry >= width ) {
+                return end - carry;
+            }
+            continue;
+        }
+
+        // a run that started in the words before
+        if( carry + __builtin_ctzll( word ) >= width ) {
+            return w * WORD_BITS - carry;
+        }
+
+        // a run inside this word, a bit is still set after this only if it starts width free spaces
+        if( width < WORD_BITS ) {
+            uint64_t fits = ~word;
+            for( int length = 1; length < width && fits; ) {
+                int shift = length < width - length ? length : width - length;
+                fits &= fits >> shift;
+                length += shift;
+            }
+
+            if( fits ) {
+                return w * WORD_BITS + __builtin_ctzll( fits );
+            }
+        }
+
+        carry = __builtin_clzll( word );
+    }
+
+    return -1;
+}
+
+/**
+  * Find the topmost, then leftmost, width by height rectangle of free spaces.
+  * @param width number of columns needed
+  * @param height number of rows needed
+  * @param row where to store the top row
+  * @param col where to store the leftmost column
+  * @return true if there is room
+*/
+static bool findRect( int width, int height, int *row, int *col ) {
+    if( width > cols || height > rows ) {
+        return false;
+    }
+
+    // rows in a row, ending at r, with a long enough run, any window with a row that doesn't is skipped
+    int tall = 0;
+    for( int r = 0; r < rows; r++ ) {
+        if( longest[ r ] < width ) {
+            tall = 0;
+            continue;
+        }
+
+        // the run of rows is cut into blocks of height rows, offset is where r is in its block
+        uint64_t const *bits = bitmap + ( long ) r * rowWords;
+        int offset = tall++ % height;
+        if( offset == 0 ) {
+            memcpy( prefix, bits, rowWords * sizeof( uint64_t ) );
+        }
+
+        else {
+            for( int w = 0; w < rowWords; w++ ) {
+                prefix[ w ] |= bits[ w ];
+            }
+        }
+
+        if( tall < height ) {
+            continue;
+        }
+
+        // a space is free in the window only if it is free in every row of it, the window is either this whole
+        // block, or the end of the block before from its row offset + 1 on, and this block so far
+        int top = r - height + 1;
+        uint64_t const *rect = prefix;
+        if( offset < height - 1 ) {
+            uint64_t const *end = suffix + ( long ) ( offset + 1 ) * rowWords;
+            for( int w = 0; w < rowWords; w++ ) {
+                window[ w ] = end[ w ] | prefix[ w ];
+            }
+            rect = window;
+        }
+
+        int found = findRun( rect, width );
+        if( found != -1 ) {
+            *row = top;
+            *col = found;
+            return true;
+        }
+
+        // the windows ending in the next block need the end of this one from each of its rows on
+        if( offset == height - 1 ) {
+            memcpy( suffix + ( long ) offset * rowWords, bits, rowWords * sizeof( uint64_t ) );
+            for( int i = offset - 1; i >= 0; i-- ) {
+                uint64_t *end = suffix + ( long ) i * rowWords;
+                uint64_t const *next = bitmap + ( long ) ( top + i ) * rowWords;
+                for( int w = 0; w < rowWords; w++ ) {
+                    end[ w ] = end[ w + rowWords ] | next[ w ];
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+  * Mark a rectangle as free or occupied, and work out each of its rows' longest run again.
+  * @param row top row
+  * @param col leftmost column
+  * @param width number of columns
+  * @param height number of rows
+  * @param isFree true to free it, false to occupy it
+*/
+static void markRect( int row, int col, int width, int height, bool isFree ) {
+    int first = col / WORD_BITS;
+    int last = ( col + width - 1 ) / WORD_BITS;
+    for( int r = row; r < row + height; r++ ) {
+        uint64_t *bits = bitmap + ( long ) r * rowWords;
+        for( int w = first; w <= last; w++ ) {
+            // the bits of this word in the rectangle
+            int lo = w == first ? col % WORD_BITS : 0;
+            int hi = w == last ? ( col + width - 1 ) % WORD_BITS : WORD_BITS - 1;
+            uint64_t mask = ( hi - lo == WORD_BITS - 1 ) ? ~0ULL : ( ( 1ULL << ( hi - lo + 1 ) ) - 1 ) << lo;
+
+            if( isFree ) {
+                bits[ w ] &= ~mask;
+            }
+
+            else {
+                bits[ w ] |= mask;
+            }
+        }
+        longest[ r ] = rowRun( r );
+    }
+}
+
+/**
+  * Hand freed space to waiters, oldest first among those it fits, until nobody left waiting fits. Each one handed
+  * space gets the same rectangle it would have found itself, and is the only one woken.
+*/
+static void grantWaiters() {
+    // a waiter at least as wide and as tall as one that didn't fit won't fit either
+    int missWidth = cols + 1;
+    int missHeight = rows + 1;
+
+    Waiter *prev = NULL;
+    Waiter *waiter = waiters;
+    while( waiter ) {
+        Waiter *next = waiter->next;
+        if( ( waiter->width >= missWidth && waiter->height >= missHeight ) ||
+            !findRect( waiter->width, waiter->height, &waiter->row, &waiter->col ) ) {
+            if( waiter->width < missWidth || waiter->height < missHeight ) {
+                missWidth = waiter->width;
+                missHeight = waiter->height;
+            }
+            prev = waiter;
+            waiter = next;
+            continue;
+        }
+
+        // take it out of line
+        if( prev ) {
+            prev->next = next;
+        }
+
+        else {
+            waiters = next;
+        }
+
+        if( lastWaiter == waiter ) {
+            lastWaiter = prev;
+        }
+
+        markRect( waiter->row, waiter->col, waiter->width, waiter->height, false );
+        logRect( EVENT_ALLOCATE, waiter->name, waiter->row, waiter->col, waiter->width, waiter->height );
+        waiter->granted = true;
+        pthread_cond_signal( &waiter->cond );
+        waiter = next;
+    }
+}
+
+bool initGrid( int r, int c ) {
+    if( r < 1 || c < 1 ) {
+        return false;
+    }
+
+    rows = r;
+    cols = c;
+    rowWords = ( cols + WORD_BITS - 1 ) / WORD_BITS;
+
+    // every row starts free, except the bits past its end
+    bitmap = ( uint64_t * )calloc( ( long ) rows * rowWords, sizeof( uint64_t ) );
+    longest = ( int * )malloc( rows * sizeof( int ) );
+    window = ( uint64_t * )malloc( rowWords * sizeof( uint64_t ) );
+    prefix = ( uint64_t * )malloc( rowWords * sizeof( uint64_t ) );
+    suffix = ( uint64_t * )malloc( ( long ) rows * rowWords * sizeof( uint64_t ) );
+    if( !bitmap || !longest || !window || !prefix || !suffix ) {
+        free( bitmap );
+        free( longest );
+        free( window );
+        free( prefix );
+        free( suffix );
+        return false;
+    }
+
+    uint64_t pad = cols % WORD_BITS ? ~0ULL << ( cols % WORD_BITS ) : 0;
+    for( int i = 0; i < rows; i++ ) {
+        bitmap[ ( long ) i * rowWords + rowWords - 1 ] = pad;
+        longest[ i ] = cols;
+    }
+
+    // initialize mutex lock
+    pthread_mutex_init( &lock, NULL );
+    waiters = lastWaiter = NULL;
+
+    // the log starts with nothing to draw, rectangles are printed by their corners
+    startEventLog( "", false );
+    return true;
+}
+
+void destroyGrid() {
+    // everything we did is printed before we go
+    stopEventLog();
+
+    free( bitmap );
+    free( longest );
+    free( window );
+    free( prefix );
+    free( suffix );
+
+    // destroy mutex lock
+    pthread_mutex_destroy( &lock );
+}
+
+bool allocateRect( char const *name, int width, int height, int *row, int *col ) {
+    // anything empty, or too big to ever fit, would wait forever
+    if( width < 1 || height < 1 || width > cols || height > rows ) {
+        return false;
+    }
+
+    // lock, with room to record what we do
+    waitForLogRoom();
+    pthread_mutex_lock( &lock );
+
+    // we have space, and nobody waiting can have fit in it, since they would have been handed it
+    if( findRect( width, height, row, col ) ) {
+        markRect( *row, *col, width, height, false );
+        logRect( EVENT_ALLOCATE, name, *row, *col, width, height );
+    }
+
+    // wait in line, whoever frees the space we need will hand it to us and report it
+    else {
+        logRect( EVENT_WAIT, name, -1, -1, width, height );
+
+        Waiter waiter;
+        waiter.name = name;
+        waiter.width = width;
+        waiter.height = height;
+        waiter.granted = false;
+        waiter.next = NULL;
+        pthread_cond_init( &waiter.cond, NULL );
+
+        if( lastWaiter ) {
+            lastWaiter->next = &waiter;
+        }
+
+        else {
+            waiters = &waiter;
+        }
+        lastWaiter = &waiter;
+
+        while( !waiter.granted ) {
+            pthread_cond_wait( &waiter.cond, &lock );
+        }
+
+        pthread_cond_destroy( &waiter.cond );
+        *row = waiter.row;
+        *col = waiter.col;
+    }
+
+    // unlock
+    pthread_mutex_unlock( &lock );
+    return true;
+}
+
+void freeRect( char const *name, int row, int col, int width, int height ) {
+    // lock, with room to record what we do
+    waitForLogRoom();
+    pthread_mutex_lock( &lock );
+
+    markRect( row, col, width, height, true );
+    logRect( EVENT_FREE, name, row, col, width, height );
+
+    // the waiters that now fit get their space before anyone else can take it
+    grantWaiters();
+
+    // unlock
+    pthread_mutex_unlock( &lock );
+}
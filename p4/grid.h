@@ -0,0 +1,47 @@
+/**
+  * @file grid.h
+  * @author Jake Donovan (jmpatte8)
+  * Header for the grid monitor, which hands out rectangles of spaces in a two dimensional hall to organizations,
+  * making them wait until there is room, the same way the hall monitor does for runs of spaces.
+*/
+
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdbool.h>
+
+/**
+  * Initialize the monitor as a hall with rows by cols spaces that can be partitioned off, and start the event log
+  * that prints what it does.
+  * @param rows number of rows of spaces, at least 1
+  * @param cols number of spaces in each row, at least 1
+  * @return false if the grid is empty or we ran out of memory
+*/
+bool initGrid( int rows, int cols );
+
+/** Destroy the monitor, printing anything still in the event log and freeing any resources it uses. */
+void destroyGrid();
+
+/**
+  * Called when an organization wants to reserve a width by height rectangle of spaces, waiting until there is room.
+  * It gets the topmost rectangle that fits, and the leftmost of those.
+  * @param name name of the organization
+  * @param width number of columns it needs, at least 1
+  * @param height number of rows it needs, at least 1
+  * @param row where to store the top row it was given
+  * @param col where to store the leftmost column it was given
+  * @return false, without waiting, if the rectangle is empty or bigger than the grid
+*/
+bool allocateRect( char const *name, int width, int height, int *row, int *col );
+
+/**
+  * Release a rectangle given out by allocateRect.
+  * @param name name of the organization
+  * @param row its top row
+  * @param col its leftmost column
+  * @param width number of columns it has
+  * @param height number of rows it has
+*/
+void freeRect( char const *name, int row, int col, int width, int height );
+
+#endif
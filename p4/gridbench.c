@@ -0,0 +1,183 @@
+/**
+  * @file gridbench.c
+  * @author Jake Donovan (jmpatte8)
+  * Benchmark for the grid monitor. A number of organization threads keep asking for rectangles of random sizes,
+  * holding them briefly and freeing them, for a fixed time. We report allocations per second and the mean and longest
+  * time allocateRect took, which includes any wait for room. The monitor's own messages go to /dev/null while it runs.
+  * Compile with grid.c and eventlog.c.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "grid.h"
+
+// Grid size, organizations, seconds and largest side when we aren't told otherwise.
+#define DEFAULT_ROWS 1000
+#define DEFAULT_COLS 1000
+#define DEFAULT_ORGS 16
+#define DEFAULT_SECONDS 2
+#define DEFAULT_SIDE 100
+
+// Microseconds an organization holds its rectangle.
+#define HOLD_US 50
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+    fprintf( stderr, "%s\n", message );
+    exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+    fprintf( stderr, "usage: gridbench [<rows> <cols> [<organizations> [<seconds> [<max-side>]]]]\n" );
+    exit( 1 );
+}
+
+/** One organization and what it saw */
+typedef struct {
+    // name, only the first letter matters to the monitor
+    char name[ 16 ];
+    // seed for its random sizes
+    unsigned seed;
+    // allocations it made, and the total and longest time allocateRect took in nanoseconds
+    long allocations;
+    long long waitNs;
+    long long maxWaitNs;
+} Org;
+
+/** Largest width or height an organization asks for */
+static int maxSide;
+
+/** Set to tell the organizations to stop asking for space */
+static atomic_bool stop;
+
+/**
+  * Current time in nanoseconds.
+  * @return monotonic clock reading
+*/
+static long long nanoTime() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+  * Start routine for each organization, asking for rectangles until told to stop.
+  * @param arg the organization
+*/
+static void *organization( void *arg ) {
+    Org *org = ( Org * )arg;
+    while( !atomic_load( &stop ) ) {
+        int width = 1 + rand_r( &org->seed ) % maxSide;
+        int height = 1 + rand_r( &org->seed ) % maxSide;
+
+        long long asked = nanoTime();
+        int row, col;
+        allocateRect( org->name, width, height, &row, &col );
+        long long waited = nanoTime() - asked;
+
+        org->allocations++;
+        org->waitNs += waited;
+        if( waited > org->maxWaitNs ) {
+            org->maxWaitNs = waited;
+        }
+
+        usleep( HOLD_US );
+        freeRect( org->name, row, col, width, height );
+    }
+
+    return NULL;
+}
+
+/**
+  * Program starting point. Runs the organizations and prints what they saw.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    int rows = DEFAULT_ROWS;
+    int cols = DEFAULT_COLS;
+    int orgs = DEFAULT_ORGS;
+    int seconds = DEFAULT_SECONDS;
+    maxSide = DEFAULT_SIDE;
+    if( argc == 2 || argc > 6 ||
+        ( argc > 2 && ( sscanf( argv[ 1 ], "%d", &rows ) != 1 || sscanf( argv[ 2 ], "%d", &cols ) != 1 ||
+                        rows < 1 || cols < 1 ) ) ||
+        ( argc > 3 && ( sscanf( argv[ 3 ], "%d", &orgs ) != 1 || orgs < 1 ) ) ||
+        ( argc > 4 && ( sscanf( argv[ 4 ], "%d", &seconds ) != 1 || seconds < 1 ) ) ||
+        ( argc > 5 && ( sscanf( argv[ 5 ], "%d", &maxSide ) != 1 || maxSide < 1 ) ) ) {
+        usage();
+    }
+
+    if( maxSide > rows || maxSide > cols ) {
+        fail( "Every rectangle has to fit in the grid" );
+    }
+
+    Org *org = ( Org * )calloc( orgs, sizeof( Org ) );
+    pthread_t *thread = ( pthread_t * )malloc( orgs * sizeof( pthread_t ) );
+    if( !org || !thread ) {
+        fail( "Out of memory" );
+    }
+
+    // keep the monitor's messages out of the results
+    fflush( stdout );
+    int saved = dup( STDOUT_FILENO );
+    int devNull = open( "/dev/null", O_WRONLY );
+    if( saved == -1 || devNull == -1 ) {
+        fail( "Can't redirect output" );
+    }
+    dup2( devNull, STDOUT_FILENO );
+    close( devNull );
+
+    if( !initGrid( rows, cols ) ) {
+        fail( "Can't make the grid" );
+    }
+    atomic_store( &stop, false );
+
+    long long start = nanoTime();
+    for( int i = 0; i < orgs; i++ ) {
+        snprintf( org[ i ].name, sizeof( org[ i ].name ), "%c%d", 'A' + i % 26, i );
+        org[ i ].seed = i + 1;
+        if( pthread_create( &thread[ i ], NULL, organization, &org[ i ] ) != 0 ) {
+            fail( "Can't create thread" );
+        }
+    }
+
+    sleep( seconds );
+    atomic_store( &stop, true );
+    for( int i = 0; i < orgs; i++ ) {
+        pthread_join( thread[ i ], NULL );
+    }
+    double elapsed = ( nanoTime() - start ) / 1e9;
+    destroyGrid();
+
+    fflush( stdout );
+    dup2( saved, STDOUT_FILENO );
+    close( saved );
+
+    long allocations = 0;
+    long long waitNs = 0, maxWaitNs = 0;
+    for( int i = 0; i < orgs; i++ ) {
+        allocations += org[ i ].allocations;
+        waitNs += org[ i ].waitNs;
+        if( org[ i ].maxWaitNs > maxWaitNs ) {
+            maxWaitNs = org[ i ].maxWaitNs;
+        }
+    }
+
+    printf( "grid: %dx%d  organizations: %d  sides: 1-%d  hold: %d us  time: %.2f s\n", rows, cols, orgs, maxSide,
+            HOLD_US, elapsed );
+    printf( "allocations: %ld  allocations/s: %.0f\n", allocations, allocations / elapsed );
+    printf( "allocateRect: mean %.1f us  max %.1f us\n", waitNs / 1e3 / allocations, maxWaitNs / 1e3 );
+
+    free( org );
+    free( thread );
+    return 0;
+}
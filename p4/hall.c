@@ -3,34 +3,1193 @@
   * @author Jake Donovan (jmpatte8)
   * This file is responsible for creating a monitor to manage a variety of organizations who want to use our hall.
   * Our monitor uses a mutex lock and condition variable and a variety of other variables to effectively and efficiently move guests
-  * between the hall.
+  * between the hall. The hall is a bitmap with one bit per space, and who has each allocation is kept in a separate table
+  * by its leftmost space. Free space is indexed by a segment tree over the bitmap's 64-bit words, so finding the leftmost
+  * run that fits takes O(log n) time no matter how big the hall is, and the last step is a few shifts within one word.
+  * Space can instead be placed in the smallest free run that fits, from free runs kept in lists by size, or in
+  * power-of-two blocks split and merged like a buddy allocator. Organizations that have to wait each get their own
+  * condition variable, and when space is freed the monitor hands it straight to the waiters it now fits, so only they
+  * are woken. If a waiter could fit in the free space but no run is long enough, the monitor slides the allocations
+  * that agreed to be moved to the left, so the free space comes together. Who goes first is up to the
+  * allocation policy, which can hold space back for a waiter that has been passed over long enough. Messages can be
+  * printed right away or recorded in the event log, so no output is done while holding the lock.
 */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
+#include <errno.h>
 #include "hall.h"
+#include "eventlog.h"
 
-/** Our hall which keeps track of all organizations in an array of chars which use '*' to indicate free space and the first letter 
-  * of an organizations name to indicate that they are occupying the hall in a certain position
+/** Our hall, one bit per space, set if an organization is occupying it. Bit b of word w is space 64w + b, and bits past
+  * the end of the hall are kept set so no run can reach them
 */
-static char * hall;
+static uint64_t * bitmap;
 
-/** Our key player, an int, in determing when there is enough space for an organization that is waiting. 1 indicates there is enough
-  * space and 0 indicates there is not enough space
+/** Number of words in bitmap */
+static int words;
+
+/** How to tell an organization its allocation moved, see allocateMovable */
+typedef struct {
+    // where the organization keeps its leftmost space, we change it when we move it
+    int *where;
+    // called after a move, or NULL
+    MoveCallback moved;
+    void *arg;
+} Mover;
+
+/** Who has an allocation in the hall */
+typedef struct {
+    // leftmost space of the allocation, or -1 for an empty entry
+    int start;
+    // number of spaces
+    int width;
+    // first letter of the organization's name, what we print for each of its spaces
+    char letter;
+    // for an allocation we can move, the organization's name and how to tell it, otherwise NULL and where is NULL
+    char const *name;
+    Mover mover;
+} Owner;
+
+/** Hash table of every allocation by its leftmost space, with linear probing. Its size is a power of two, at least
+  * twice the number of allocations
+*/
+static Owner * owners;
+static int ownerCapacity;
+static int ownerCount;
+
+/** Number of allocations in owners that can be moved */
+static int movable;
+
+/** A free run for PLACEMENT_BEST_FIT, or a free block for PLACEMENT_BUDDY */
+typedef struct BlockStruct {
+    // leftmost space, and number of spaces
+    int start;
+    int length;
+    // neighbors in the list for its size class
+    struct BlockStruct *prev;
+    struct BlockStruct *next;
+} Block;
+
+// Number of size classes, class c holds blocks from 2^c up to 2^(c + 1) - 1 spaces.
+#define SIZE_CLASSES 32
+
+/** Free blocks in each size class, in no particular order */
+static Block * sizeClass[ SIZE_CLASSES ];
+
+/** Entry in blockTable */
+typedef struct {
+    // leftmost or rightmost space, see blockKey
+    int key;
+    // the block, or NULL for an empty entry
+    Block *block;
+} BlockEntry;
+
+/** Hash table of free blocks, with linear probing like owners. Each block is found by its leftmost space, and free
+  * runs are also found by their rightmost space so a freed neighbor can merge with them
+*/
+static BlockEntry * blockTable;
+static int blockCapacity;
+static int blockCount;
+
+/** The hall as a string, '*' for a free space and the first letter of an organization's name for a space it occupies.
+  * Only made when something needs to print it
+*/
+static char * view;
+
+/** What a segment tree node knows about the free spaces in its part of the hall */
+typedef struct {
+    // longest run of free spaces anywhere in the node
+    int best;
+    // free spaces in a row starting at the node's left end
+    int prefix;
+    // free spaces in a row ending at the node's right end
+    int suffix;
+} FreeRun;
+
+/** Segment tree over the bitmap, node 1 is the root, node i has children 2i and 2i + 1, and the leaves start at leaves.
+  * Leaf k covers the 64 spaces in word k, and leaves past the last word are kept occupied.
+*/
+static FreeRun * tree;
+
+/** Number of leaves in the tree, the smallest power of two that covers the bitmap */
+static int leaves;
+
+// Spaces in each bitmap word, and so under each leaf of the tree.
+#define WORD_BITS 64
+
+/** Our mutex lock to prevent two organizations from accessing the monitor at a time */
+pthread_mutex_t lock;
+
+/** Keep track of length of hall aka the number of spaces */
+static int len;
+
+/** An organization waiting for space, it lives on the waiting thread's stack */
+typedef struct WaiterStruct {
+    // name of the organization
+    char const *name;
+    // number of spaces it needs
+    int width;
+    // order it started waiting in, lower waited longer
+    long ticket;
+    // when it started waiting, in nanoseconds
+    long long since;
+    // times someone went ahead of it while it was at the front of the line
+    int bypassed;
+    // set once space has been handed to it
+    bool granted;
+    // leftmost space it was handed
+    int start;
+    // how to tell it its space moved, or NULL if it can't be moved
+    Mover const *mover;
+    // signaled only when this organization is handed space
+    pthread_cond_t cond;
+    // for a batch, its requests widest first and how many there are, otherwise NULL, width is then the total
+    SpaceRequest **batch;
+    int count;
+    // next waiter with the same width, or the next batch
+    struct WaiterStruct *next;
+    // for the first waiter of each width only, first waiter of the next larger width and last waiter of this width
+    struct WaiterStruct *nextWidth;
+    struct WaiterStruct *tail;
+} Waiter;
+
+/** First waiter of the smallest waiting width. Each width's waiters are in the order they arrived, and the widths
+  * are in increasing order, so the waiters that fit in a run are the ones before the first width that doesn't
+*/
+static Waiter * waiters;
+
+/** Batches waiting to be placed all at once, oldest first */
+static Waiter * batchWaiters;
+
+/** Ticket for the next organization to wait */
+static long nextTicket;
+
+/** How we choose who gets space, and the bound that goes with it, see setAllocationPolicy */
+static int policy = POLICY_LEFTMOST;
+static int bound;
+
+/** Where we put the space we give out, see setPlacement */
+static int placement;
+
+/** How we report what we do, see setLogMode */
+static int logMode;
+
+/** Counts for getMonitorStats */
+static MonitorStats stats;
+
+/** When the current holder of lock got it */
+static struct timespec holdStart;
+
+/**
+  * Recompute a node from its two children.
+  * @param i index of the node
+  * @param width number of spaces under the node
+*/
+static void pull( int i, int width ) {
+    FreeRun *left = &tree[ 2 * i ];
+    FreeRun *right = &tree[ 2 * i + 1 ];
+    int half = width / 2;
+
+    // a run can only carry across the middle if one side is entirely free
+    tree[ i ].prefix = left->prefix == half ? half + right->prefix : left->prefix;
+    tree[ i ].suffix = right->suffix == half ? half + left->suffix : right->suffix;
+
+    int best = left->suffix + right->prefix;
+    if( left->best > best ) {
+        best = left->best;
+    }
+    if( right->best > best ) {
+        best = right->best;
+    }
+    tree[ i ].best = best;
+}
+
+/**
+  * Work out a leaf of the tree from its bitmap word, using ctz and clz to measure each free run.
+  * @param word the bitmap word, a set bit is an occupied space
+  * @param run where to store the runs
+*/
+static void wordRuns( uint64_t word, FreeRun *run ) {
+    if( word == 0 ) {
+        run->best = run->prefix = run->suffix = WORD_BITS;
+        return;
+    }
+
+    // low bits are the leftmost spaces
+    run->prefix = __builtin_ctzll( word );
+    run->suffix = __builtin_clzll( word );
+
+    // hop from one free run to the next, some bit is occupied so no run is the whole word
+    uint64_t free = ~word;
+    int best = 0;
+    while( free ) {
+        free >>= __builtin_ctzll( free );
+        int length = __builtin_ctzll( ~free );
+        if( length > best ) {
+            best = length;
+        }
+        free >>= length;
+    }
+    run->best = best;
+}
+
+/**
+  * Find the leftmost run of free spaces within one bitmap word.
+  * @param word the bitmap word
+  * @param width number of spaces needed, the word must have a run this long
+  * @return bit where the run starts
+*/
+static int firstRun( uint64_t word, int width ) {
+    // after this a bit is still set only if it starts a run of width free spaces, doubling the length each step
+    uint64_t fits = ~word;
+    for( int length = 1; length < width; ) {
+        int shift = length < width - length ? length : width - length;
+        fits &= fits >> shift;
+        length += shift;
+    }
+
+    return __builtin_ctzll( fits );
+}
+
+/**
+  * Mark spaces from start up to start + width - 1 as free or occupied, then fix every node above them.
+  * Touches O(width / 64 + log n) words and nodes, since each level up has about half as many to fix.
+  * @param start the leftmost space
+  * @param width number of spaces
+  * @param isFree true to free them, false to occupy them
+*/
+static void markSpace( int start, int width, bool isFree ) {
+    int first = start / WORD_BITS;
+    int last = ( start + width - 1 ) / WORD_BITS;
+
+    for( int w = first; w <= last; w++ ) {
+        // the bits of this word in the range
+        int lo = w == first ? start % WORD_BITS : 0;
+        int hi = w == last ? ( start + width - 1 ) % WORD_BITS : WORD_BITS - 1;
+        uint64_t mask = ( hi - lo == WORD_BITS - 1 ) ? ~0ULL : ( ( 1ULL << ( hi - lo + 1 ) ) - 1 ) << lo;
+
+        if( isFree ) {
+            bitmap[ w ] &= ~mask;
+        }
+
+        else {
+            bitmap[ w ] |= mask;
+        }
+        wordRuns( bitmap[ w ], &tree[ leaves + w ] );
+    }
+    stats.freeSpaces += isFree ? width : -width;
+
+    int lo = leaves + first;
+    int hi = leaves + last;
+    for( int size = 2 * WORD_BITS; lo > 1; size *= 2 ) {
+        lo /= 2;
+        hi /= 2;
+        for( int i = lo; i <= hi; i++ ) {
+            pull( i, size );
+        }
+    }
+}
+
+/**
+  * Find the leftmost run of width free spaces, the same run a scan from the left end of the hall would find.
+  * @param width number of spaces needed
+  * @return index of the leftmost space in the run, or -1 if there is no room
+*/
+static int findSpace( int width ) {
+    if( tree[ 1 ].best < width ) {
+        return -1;
+    }
+
+    int i = 1;
+    int lo = 0;
+    int size = leaves * WORD_BITS;
+    while( i < leaves ) {
+        int half = size / 2;
+        // prefer a run entirely in the left half, then one across the middle, then the right half
+        if( tree[ 2 * i ].best >= width ) {
+            i = 2 * i;
+        }
+
+        else if( tree[ 2 * i ].suffix + tree[ 2 * i + 1 ].prefix >= width ) {
+            return lo + half - tree[ 2 * i ].suffix;
+        }
+
+        else {
+            i = 2 * i + 1;
+            lo += half;
+        }
+
+        size = half;
+    }
+
+    // the run is inside this leaf's word
+    return lo + firstRun( bitmap[ i - leaves ], width );
+}
+
+/**
+  * Where a space hashes to in a table.
+  * @param key the space, or for blockTable, a key made from one
+  * @param mask table size minus one
+  * @return index it hashes to
+*/
+static unsigned hashSpace( int key, unsigned mask ) {
+    return ( unsigned ) key * 2654435761u & mask;
+}
+
+/**
+  * Find where an allocation's entry is, or would go, in the owner table.
+  * @param start leftmost space of the allocation
+  * @return index of its entry, or of the empty entry where it would go
+*/
+static int ownerSlot( int start ) {
+    unsigned mask = ownerCapacity - 1;
+    unsigned i = hashSpace( start, mask );
+    while( owners[ i ].start != -1 && owners[ i ].start != start ) {
+        i = ( i + 1 ) & mask;
+    }
+
+    return i;
+}
+
+/**
+  * Record who has an allocation, making the table bigger first if it is half full.
+  * @param start leftmost space of the allocation
+  * @param width number of spaces
+  * @param name name of the organization
+  * @param mover how to tell it its allocation moved, or NULL if it can't be moved
+*/
+static void addOwner( int start, int width, char const *name, Mover const *mover ) {
+    if( ( ownerCount + 1 ) * 2 > ownerCapacity ) {
+        Owner *old = owners;
+        int oldCapacity = ownerCapacity;
+        ownerCapacity *= 2;
+        owners = ( Owner * )malloc( ownerCapacity * sizeof( Owner ) );
+        for( int i = 0; i < ownerCapacity; i++ ) {
+            owners[ i ].start = -1;
+        }
+
+        for( int i = 0; i < oldCapacity; i++ ) {
+            if( old[ i ].start != -1 ) {
+                owners[ ownerSlot( old[ i ].start ) ] = old[ i ];
+            }
+        }
+        free( old );
+    }
+
+    Owner *owner = &owners[ ownerSlot( start ) ];
+    owner->start = start;
+    owner->width = width;
+    owner->letter = name[ 0 ];
+    owner->name = mover ? name : NULL;
+    owner->mover.where = NULL;
+    if( mover ) {
+        owner->mover = *mover;
+        *mover->where = start;
+        movable++;
+    }
+    ownerCount++;
+}
+
+/**
+  * Forget who had an allocation. Entries after it that were pushed along by it are moved back, so every entry
+  * stays reachable from where it hashes to.
+  * @param start leftmost space of the allocation
+*/
+static void removeOwner( int start ) {
+    unsigned mask = ownerCapacity - 1;
+    unsigned hole = ownerSlot( start );
+    if( owners[ hole ].start == -1 ) {
+        return;
+    }
+
+    if( owners[ hole ].mover.where ) {
+        movable--;
+    }
+
+    for( unsigned i = ( hole + 1 ) & mask; owners[ i ].start != -1; i = ( i + 1 ) & mask ) {
+        // an entry can fill the hole if the hole is between where it hashes to and where it is
+        unsigned home = hashSpace( owners[ i ].start, mask );
+        if( ( ( i - home ) & mask ) >= ( ( i - hole ) & mask ) ) {
+            owners[ hole ] = owners[ i ];
+            hole = i;
+        }
+    }
+
+    owners[ hole ].start = -1;
+    ownerCount--;
+}
+
+/**
+  * Make the hall into a string for printing, from the bitmap and the owner table.
+  * @return the hall, '*' for each free space and the first letter of its organization's name for each occupied one
+*/
+static char *renderHall() {
+    if( !view ) {
+        view = ( char * )malloc( len + 1 );
+        view[ len ] = '\0';
+    }
+
+    // every occupied space we come to is the leftmost space of some allocation
+    for( int i = 0; i < len; ) {
+        if( !( bitmap[ i / WORD_BITS ] >> ( i % WORD_BITS ) & 1 ) ) {
+            view[ i++ ] = '*';
+            continue;
+        }
+
+        Owner *owner = &owners[ ownerSlot( i ) ];
+        memset( view + i, owner->letter, owner->width );
+        i += owner->width;
+    }
+
+    return view;
+}
+
+/**
+  * Key for finding a block in blockTable.
+  * @param space leftmost space of the block, or rightmost space for a free run's second entry
+  * @param isEnd true for a rightmost space
+  * @return the key
+*/
+static int blockKey( int space, bool isEnd ) {
+    return 2 * space + isEnd;
+}
+
+/**
+  * Find where a key's entry is, or would go, in blockTable.
+  * @param key the key
+  * @return index of its entry, or of the empty entry where it would go
+*/
+static int blockSlot( int key ) {
+    unsigned mask = blockCapacity - 1;
+    unsigned i = hashSpace( key, mask );
+    while( blockTable[ i ].block && blockTable[ i ].key != key ) {
+        i = ( i + 1 ) & mask;
+    }
+
+    return i;
+}
+
+/**
+  * Find a free block by one of its keys.
+  * @param key the key
+  * @return the block, or NULL if no free block has that key
+*/
+static Block *findBlock( int key ) {
+    return blockTable[ blockSlot( key ) ].block;
+}
+
+/**
+  * Add a key for a block to blockTable, making the table bigger first if it is half full.
+  * @param key the key
+  * @param block the block
+*/
+static void addBlockKey( int key, Block *block ) {
+    if( ( blockCount + 1 ) * 2 > blockCapacity ) {
+        BlockEntry *old = blockTable;
+        int oldCapacity = blockCapacity;
+        blockCapacity *= 2;
+        blockTable = ( BlockEntry * )calloc( blockCapacity, sizeof( BlockEntry ) );
+        for( int i = 0; i < oldCapacity; i++ ) {
+            if( old[ i ].block ) {
+                blockTable[ blockSlot( old[ i ].key ) ] = old[ i ];
+            }
+        }
+        free( old );
+    }
+
+    BlockEntry *entry = &blockTable[ blockSlot( key ) ];
+    entry->key = key;
+    entry->block = block;
+    blockCount++;
+}
+
+/**
+  * Take a key out of blockTable, moving back entries that were pushed along by it like removeOwner does.
+  * @param key the key
+*/
+static void removeBlockKey( int key ) {
+    unsigned mask = blockCapacity - 1;
+    unsigned hole = blockSlot( key );
+    for( unsigned i = ( hole + 1 ) & mask; blockTable[ i ].block; i = ( i + 1 ) & mask ) {
+        unsigned home = hashSpace( blockTable[ i ].key, mask );
+        if( ( ( i - home ) & mask ) >= ( ( i - hole ) & mask ) ) {
+            blockTable[ hole ] = blockTable[ i ];
+            hole = i;
+        }
+    }
+
+    blockTable[ hole ].block = NULL;
+    blockCount--;
+}
+
+/**
+  * Size class for a number of spaces.
+  * @param length number of spaces, at least 1
+  * @return its size class, the floor of its base 2 log
+*/
+static int classOf( int length ) {
+    return 31 - __builtin_clz( length );
+}
+
+/**
+  * Record a free block, in the list for its size class and in blockTable.
+  * @param start leftmost space
+  * @param length number of spaces
+*/
+static void addBlock( int start, int length ) {
+    Block *block = ( Block * )malloc( sizeof( Block ) );
+    block->start = start;
+    block->length = length;
+
+    Block **head = &sizeClass[ classOf( length ) ];
+    block->prev = NULL;
+    block->next = *head;
+    if( *head ) {
+        ( *head )->prev = block;
+    }
+    *head = block;
+
+    addBlockKey( blockKey( start, false ), block );
+    if( placement == PLACEMENT_BEST_FIT ) {
+        addBlockKey( blockKey( start + length - 1, true ), block );
+    }
+}
+
+/**
+  * Forget a free block that has just been given out or merged with a neighbor.
+  * @param block the block
+*/
+static void removeBlock( Block *block ) {
+    if( block->prev ) {
+        block->prev->next = block->next;
+    }
+
+    else {
+        sizeClass[ classOf( block->length ) ] = block->next;
+    }
+
+    if( block->next ) {
+        block->next->prev = block->prev;
+    }
+
+    removeBlockKey( blockKey( block->start, false ) );
+    if( placement == PLACEMENT_BEST_FIT ) {
+        removeBlockKey( blockKey( block->start + block->length - 1, true ) );
+    }
+    free( block );
+}
+
+/** Forget every free block, leaving an empty table. */
+static void clearBlocks() {
+    for( int c = 0; c < SIZE_CLASSES; c++ ) {
+        while( sizeClass[ c ] ) {
+            Block *next = sizeClass[ c ]->next;
+            free( sizeClass[ c ] );
+            sizeClass[ c ] = next;
+        }
+    }
+
+    free( blockTable );
+    blockCapacity = 16;
+    blockCount = 0;
+    blockTable = ( BlockEntry * )calloc( blockCapacity, sizeof( BlockEntry ) );
+}
+
+/**
+  * Number of spaces an organization is really given when it asks for width, a buddy block is a power of two.
+  * @param width number of spaces asked for
+  * @return number of spaces to give it
+*/
+static int blockWidth( int width ) {
+    if( placement != PLACEMENT_BUDDY || width <= 1 ) {
+        return width;
+    }
+
+    return 1 << ( 32 - __builtin_clz( width - 1 ) );
+}
+
+/**
+  * Find the smallest free run with room for width spaces. Every run in a higher size class is longer than every run in
+  * a lower one, so only the first class with a run that fits has to be searched.
+  * @param width number of spaces needed
+  * @return leftmost space of the run, or -1 if there is no room
+*/
+static int bestFit( int width ) {
+    for( int c = classOf( width ); c < SIZE_CLASSES; c++ ) {
+        Block *best = NULL;
+        for( Block *block = sizeClass[ c ]; block; block = block->next ) {
+            if( block->length >= width && ( !best || block->length < best->length ||
+                ( block->length == best->length && block->start < best->start ) ) ) {
+                best = block;
+            }
+        }
+
+        if( best ) {
+            return best->start;
+        }
+    }
+
+    return -1;
+}
+
+/**
+  * Find a free buddy block of width spaces, or the smallest bigger one to split.
+  * @param width number of spaces needed, a power of two
+  * @return leftmost space of the block, or -1 if there is no room
+*/
+static int buddyFit( int width ) {
+    for( int c = classOf( width ); c < SIZE_CLASSES; c++ ) {
+        if( sizeClass[ c ] ) {
+            return sizeClass[ c ]->start;
+        }
+    }
+
+    return -1;
+}
+
+/**
+  * Find where to put width spaces.
+  * @param width number of spaces needed, already rounded up by blockWidth
+  * @return leftmost space to give, or -1 if there is no room
+*/
+static int placeSpace( int width ) {
+    if( placement == PLACEMENT_BEST_FIT ) {
+        return bestFit( width );
+    }
+
+    if( placement == PLACEMENT_BUDDY ) {
+        return buddyFit( width );
+    }
+
+    return findSpace( width );
+}
+
+/**
+  * The widest request placeSpace could find room for right now.
+  * @return number of spaces
+*/
+static int largestPlaceable() {
+    if( placement == PLACEMENT_BUDDY ) {
+        for( int c = SIZE_CLASSES - 1; c >= 0; c-- ) {
+            if( sizeClass[ c ] ) {
+                return 1 << c;
+            }
+        }
+
+        return 0;
+    }
+
+    // free runs are as long as they can be, so the longest one is the longest run in the hall
+    return tree[ 1 ].best;
+}
+
+/**
+  * Take spaces placeSpace found out of the free blocks. A best-fit run gives up its left end, and a buddy block is
+  * split in half until it is the size asked for, the halves we don't use staying free.
+  * @param start the leftmost space, where placeSpace found a block
+  * @param width number of spaces
+*/
+static void takeBlock( int start, int width ) {
+    Block *block = findBlock( blockKey( start, false ) );
+    int length = block->length;
+    removeBlock( block );
+
+    if( placement == PLACEMENT_BEST_FIT ) {
+        if( length > width ) {
+            addBlock( start + width, length - width );
+        }
+    }
+
+    else {
+        while( length > width ) {
+            length /= 2;
+            addBlock( start + length, length );
+        }
+    }
+}
+
+/**
+  * Give freed spaces back to the free blocks, merging them with free neighbors. A best-fit run merges with the runs
+  * on either side, and a buddy block merges with its buddy as long as the buddy is free and whole.
+  * @param start the leftmost space
+  * @param width number of spaces
+*/
+static void returnBlock( int start, int width ) {
+    if( placement == PLACEMENT_BEST_FIT ) {
+        Block *left = start > 0 ? findBlock( blockKey( start - 1, true ) ) : NULL;
+        Block *right = findBlock( blockKey( start + width, false ) );
+        if( left ) {
+            start = left->start;
+            width += left->length;
+            removeBlock( left );
+        }
+
+        if( right ) {
+            width += right->length;
+            removeBlock( right );
+        }
+    }
+
+    else {
+        for( ;; ) {
+            Block *buddy = findBlock( blockKey( start ^ width, false ) );
+            if( !buddy || buddy->length != width ) {
+                break;
+            }
+
+            removeBlock( buddy );
+            start &= ~width;
+            width *= 2;
+        }
+    }
+
+    addBlock( start, width );
+}
+
+/** Note that we just got the lock, so we can time how long we hold it */
+static void startHold() {
+    clock_gettime( CLOCK_MONOTONIC, &holdStart );
+}
+
+/** Note that we are about to let go of the lock, adding how long we held it to stats */
+static void endHold() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    long long held = ( now.tv_sec - holdStart.tv_sec ) * 1000000000LL + ( now.tv_nsec - holdStart.tv_nsec );
+    stats.lockHolds++;
+    stats.lockHoldNs += held;
+    if( held > stats.maxLockHoldNs ) {
+        stats.maxLockHoldNs = held;
+    }
+}
+
+/** Lock the monitor */
+static void lockMonitor() {
+    // make room to log what we do, we can't wait for the logger once we have the lock
+    waitForLogRoom();
+
+    // try first, so we can count the times someone else had it
+    if( pthread_mutex_trylock( &lock ) != 0 ) {
+        pthread_mutex_lock( &lock );
+        stats.contended++;
+    }
+    startHold();
+}
+
+/** Unlock the monitor */
+static void unlockMonitor() {
+    endHold();
+    pthread_mutex_unlock( &lock );
+}
+
+/**
+  * Current time in nanoseconds.
+  * @return monotonic clock reading
+*/
+static long long nanoTime() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/**
+  * How urgently an organization should get space under POLICY_AGING. Narrow ones start ahead, and every
+  * waiter gains on them as it waits, bound microseconds of waiting make up for one space of width.
+  * @param width number of spaces it needs
+  * @param waited nanoseconds it has waited, 0 for one that just arrived
+  * @return priority, higher goes first
+*/
+static long long priority( int width, long long waited ) {
+    return waited - ( long long ) width * bound * 1000;
+}
+
+/**
+  * Check whether one waiter goes before another under the current policy.
+  * @param a a waiter
+  * @param b another waiter
+  * @param now current time in nanoseconds
+  * @return true if a goes first
+*/
+static bool ahead( Waiter *a, Waiter *b, long long now ) {
+    if( policy == POLICY_AGING ) {
+        long long pa = priority( a->width, now - a->since );
+        long long pb = priority( b->width, now - b->since );
+        if( pa != pb ) {
+            return pa > pb;
+        }
+    }
+
+    return a->ticket < b->ticket;
+}
+
+/**
+  * Find the waiter at the front of the line, whether it fits or not. Only the first waiter of each width can be.
+  * @param now current time in nanoseconds
+  * @return the front waiter, or NULL if nobody is waiting
+*/
+static Waiter *frontWaiter( long long now ) {
+    Waiter *front = waiters;
+    for( Waiter *head = waiters; head; head = head->nextWidth ) {
+        if( ahead( head, front, now ) ) {
+            front = head;
+        }
+    }
+
+    return front;
+}
+
+/**
+  * Check whether an organization may take space ahead of the waiter at the front of the line, which doesn't fit.
+  * This only checks, call countPass once the organization has actually taken the space.
+  * @param width number of spaces the organization needs
+  * @param waited nanoseconds it has waited, 0 for one that just arrived
+  * @param front the front waiter
+  * @param now current time in nanoseconds
+  * @return true if it may go
+*/
+static bool mayPass( int width, long long waited, Waiter *front, long long now ) {
+    if( policy == POLICY_FIFO ) {
+        return front->bypassed < bound;
+    }
+
+    if( policy == POLICY_AGING ) {
+        return priority( width, waited ) >= priority( front->width, now - front->since );
+    }
+
+    return true;
+}
+
+/**
+  * Count a pass mayPass allowed against the front waiter, under POLICY_FIFO it can only be passed bound times.
+  * @param front the front waiter
+*/
+static void countPass( Waiter *front ) {
+    if( policy == POLICY_FIFO ) {
+        front->bypassed++;
+    }
+}
+
+/**
+  * Report something the monitor did, after the hall has been updated for it.
+  * @param type EVENT_WAIT, EVENT_ALLOCATE or EVENT_FREE
+  * @param name name of the organization
+  * @param start leftmost space it is about
+  * @param width number of spaces
+*/
+static void report( int type, char const *name, int start, int width ) {
+    if( logMode != LOG_DIRECT ) {
+        logEvent( type, name, start, width );
+        return;
+    }
+
+    if( type == EVENT_WAIT ) {
+        // print waiting message
+        printf( "%s", name );
+        printf( "%s", " waiting: " );
+        printf("%s\n", renderHall() );
+    }
+
+    else if( type == EVENT_ALLOCATE ) {
+        // print allocation message
+        printf( "%s", name );
+        printf( "%s", " allocated: " );
+        printf("%s\n", renderHall() );
+    }
+
+    else if( type == EVENT_FREE ) {
+        // print freed message
+        printf( "%s", name );
+        printf("%s", " freed: " );
+        printf("%s\n", renderHall() );
+    }
+
+    else {
+        // print give up message
+        printf( "%s", name );
+        printf("%s", " gave up: " );
+        printf("%s\n", renderHall() );
+    }
+}
+
+/**
+  * Give spaces to an organization, in the hall, the owner table, the tree and the free blocks if we keep them.
+  * @param name name of the organization
+  * @param start the leftmost space
+  * @param width number of spaces
+  * @param mover how to tell it the spaces moved, or NULL if they can't be moved
 */
-static volatile int isSpace;
+static void occupySpace( char const *name, int start, int width, Mover const *mover ) {
+    addOwner( start, width, name, mover );
+    markSpace( start, width, false );
+    if( placement != PLACEMENT_LEFTMOST ) {
+        takeBlock( start, width );
+    }
+}
 
-/** Our mutex lock to prevent two organizations from accessing the monitor at a time */
-pthread_mutex_t lock;
+/**
+  * Find the next occupied space.
+  * @param from where to start looking
+  * @return the first occupied space at or after from, or -1 if there isn't one
+*/
+static int nextOccupied( int from ) {
+    if( from >= len ) {
+        return -1;
+    }
 
-/** Our condition variable to determine when we have enough space for an organization waiting to enter hall */
-pthread_cond_t cond;
+    int w = from / WORD_BITS;
+    uint64_t bits = bitmap[ w ] & ( ~0ULL << ( from % WORD_BITS ) );
+    while( !bits ) {
+        if( ++w == words ) {
+            return -1;
+        }
+        bits = bitmap[ w ];
+    }
 
-/** Keep track of length of hall aka the number of spaces */
-static int len;
+    // the bits past the end of the hall are set too
+    int space = w * WORD_BITS + __builtin_ctzll( bits );
+    return space < len ? space : -1;
+}
+
+/**
+  * Move an allocation that agreed to be moved, and tell its organization.
+  * @param owner a copy of its entry in the owner table
+  * @param to its new leftmost space, the spaces from there up to where it is now have to be free
+*/
+static void moveSpace( Owner const *owner, int to ) {
+    int from = owner->start;
+    removeOwner( from );
+    markSpace( from, owner->width, true );
+    if( placement != PLACEMENT_LEFTMOST ) {
+        returnBlock( from, owner->width );
+    }
+
+    occupySpace( owner->name, to, owner->width, &owner->mover );
+    stats.moves++;
+    if( logMode != LOG_DIRECT ) {
+        logMove( owner->name, from, to, owner->width );
+    }
+
+    else {
+        printf( "%s moved: %s\n", owner->name, renderHall() );
+    }
+
+    if( owner->mover.moved ) {
+        owner->mover.moved( owner->mover.arg, from, to );
+    }
+}
+
+/**
+  * Slide every allocation that can be moved as far left as it will go, keeping them in order. Allocations that can't
+  * be moved stay put, and the ones after them pack up against them instead.
+*/
+static void compactHall() {
+    // first space after everything packed so far
+    int packed = 0;
+    for( int space = nextOccupied( 0 ); space != -1; space = nextOccupied( packed ) ) {
+        Owner owner = owners[ ownerSlot( space ) ];
+        if( owner.mover.where && space > packed ) {
+            moveSpace( &owner, packed );
+            packed += owner.width;
+        }
+
+        else {
+            packed = space + owner.width;
+        }
+    }
+}
+
+/**
+  * Take a waiter out of the line.
+  * @param head the list entry pointing to the first waiter of its width
+  * @param waiter the waiter
+*/
+static void removeWaiter( Waiter **head, Waiter *waiter ) {
+    Waiter *first = *head;
+
+    // the next waiter of the same width, if any, takes its place in the list of widths
+    if( waiter == first ) {
+        if( waiter->next ) {
+            waiter->next->nextWidth = waiter->nextWidth;
+            waiter->next->tail = waiter->tail;
+            *head = waiter->next;
+        }
+
+        else {
+            *head = waiter->nextWidth;
+        }
+
+        return;
+    }
+
+    Waiter *prev = first;
+    while( prev->next != waiter ) {
+        prev = prev->next;
+    }
+
+    prev->next = waiter->next;
+    if( first->tail == waiter ) {
+        first->tail = prev;
+    }
+}
+
+/**
+  * Add a waiter behind every other waiter of its width.
+  * @param waiter the new waiter
+*/
+static void addWaiter( Waiter *waiter ) {
+    waiter->next = waiter->nextWidth = NULL;
+    waiter->tail = waiter;
+
+    Waiter **head = &waiters;
+    while( *head && ( *head )->width < waiter->width ) {
+        head = &( *head )->nextWidth;
+    }
+
+    // first waiter of this width
+    if( !*head || ( *head )->width != waiter->width ) {
+        waiter->nextWidth = *head;
+        *head = waiter;
+    }
+
+    else {
+        ( *head )->tail->next = waiter;
+        ( *head )->tail = waiter;
+    }
+}
+
+/**
+  * Place every request in a batch, widest first, or none of them. Nothing is reported unless they all fit.
+  * @param order the requests, widest first, each one's start is set to where it was put
+  * @param count number of requests
+  * @return true if they all have space
+*/
+static bool placeBatch( SpaceRequest **order, int count ) {
+    int placed = 0;
+    for( ; placed < count; placed++ ) {
+        int width = blockWidth( order[ placed ]->width );
+        int start = placeSpace( width );
+        if( start == -1 ) {
+            break;
+        }
+
+        occupySpace( order[ placed ]->name, start, width, NULL );
+        order[ placed ]->start = start;
+    }
+
+    if( placed == count ) {
+        for( int i = 0; i < count; i++ ) {
+            int width = blockWidth( order[ i ]->width );
+            report( EVENT_ALLOCATE, order[ i ]->name, order[ i ]->start, width );
+            stats.allocations++;
+            stats.padding += width - order[ i ]->width;
+        }
+
+        return true;
+    }
+
+    // give back what we took, last first, so the free blocks merge back the way they were
+    while( placed-- > 0 ) {
+        int width = blockWidth( order[ placed ]->width );
+        removeOwner( order[ placed ]->start );
+        markSpace( order[ placed ]->start, width, true );
+        if( placement != PLACEMENT_LEFTMOST ) {
+            returnBlock( order[ placed ]->start, width );
+        }
+        order[ placed ]->start = -1;
+    }
+
+    return false;
+}
+
+/**
+  * Hand freed space to waiting batches, oldest first, each one only if all of its requests can be placed together. If
+  * a batch would fit in the free space if it were all together, we compact the hall once and try it again.
+  * @param compacted set once we have compacted, and we don't compact again if it already is
+*/
+static void grantBatches( bool *compacted ) {
+    Waiter **link = &batchWaiters;
+    while( *link ) {
+        Waiter *waiter = *link;
+        if( waiter->width <= stats.freeSpaces && placeBatch( waiter->batch, waiter->count ) ) {
+            *link = waiter->next;
+            waiter->granted = true;
+            stats.waiting -= waiter->count;
+            pthread_cond_signal( &waiter->cond );
+            continue;
+        }
+
+        if( !*compacted && movable && placement != PLACEMENT_BUDDY && waiter->width <= stats.freeSpaces ) {
+            compactHall();
+            *compacted = true;
+            continue;
+        }
+
+        link = &waiter->next;
+    }
+}
+
+/**
+  * Hand freed space to waiters, batches first, then first in line first among those that fit, until nobody left
+  * waiting fits or the policy holds the space for a waiter that doesn't fit yet. Each one handed space gets the same
+  * space it would have found itself, and is the only one woken. If the waiter we're stuck on would fit in the free
+  * space if it were all together, we compact the hall once and keep going.
+*/
+static void grantWaiters() {
+    long long now = policy == POLICY_LEFTMOST ? 0 : nanoTime();
+    bool compacted = false;
+    grantBatches( &compacted );
+    while( waiters ) {
+        int best = largestPlaceable();
+
+        // only the first waiter of each width could be next, and only widths up to best fit
+        Waiter **pick = NULL;
+        for( Waiter **head = &waiters; *head && ( *head )->width <= best; head = &( *head )->nextWidth ) {
+            if( !pick || ahead( *head, *pick, now ) ) {
+                pick = head;
+            }
+        }
+
+        // going ahead of a waiter that doesn't fit yet is up to the policy
+        bool held = false;
+        if( pick && policy != POLICY_LEFTMOST ) {
+            Waiter *front = frontWaiter( now );
+            if( front != *pick ) {
+                held = !mayPass( ( *pick )->width, now - ( *pick )->since, front, now );
+                if( !held ) {
+                    countPass( front );
+                }
+            }
+        }
+
+        if( !pick || held ) {
+            // the narrowest waiter, or the one the policy is holding space for
+            Waiter *stuck = policy == POLICY_LEFTMOST ? waiters : frontWaiter( now );
+            if( compacted || !movable || placement == PLACEMENT_BUDDY || stuck->width > stats.freeSpaces ) {
+                break;
+            }
+
+            compactHall();
+            compacted = true;
+            continue;
+        }
+
+        Waiter *waiter = *pick;
+        removeWaiter( pick, waiter );
+
+        waiter->start = placeSpace( waiter->width );
+        occupySpace( waiter->name, waiter->start, waiter->width, waiter->mover );
+        report( EVENT_ALLOCATE, waiter->name, waiter->start, waiter->width );
+        waiter->granted = true;
+        stats.waiting--;
+        pthread_cond_signal( &waiter->cond );
+    }
+}
 
 /** 
   * Initialize the monitor as a hall with n spaces that can be partitioned
@@ -41,171 +1200,232 @@ void initMonitor( int n ) {
     // initialize mutex lock
     pthread_mutex_init( &lock, NULL );
 
-    // initialize condition variable
-    pthread_cond_init( &cond, NULL );
+    // nobody is waiting yet, and we print as we go until told otherwise
+    logMode = LOG_DIRECT;
+    waiters = NULL;
+    batchWaiters = NULL;
+    nextTicket = 0;
+    movable = 0;
+    memset( &stats, 0, sizeof( stats ) );
 
-    // initialize hall
-    hall = ( char * )malloc( sizeof( char ) * n );
+    // initialize hall with every bit set, then free the real spaces so the tree is built in one pass
+    len = n;
+    words = ( n + WORD_BITS - 1 ) / WORD_BITS;
+    bitmap = ( uint64_t * )malloc( words * sizeof( uint64_t ) );
+    memset( bitmap, 0xff, words * sizeof( uint64_t ) );
+    view = NULL;
 
-    // initialize hall with aterisks = '*' indicating that space is available
-    for( int i = 0; i < n; i++ ) {
-        hall[ i ] = '*';
-    }
+    // every leaf starts occupied
+    for( leaves = 1; leaves < words; leaves *= 2 )
+        ;
+    tree = ( FreeRun * )calloc( 2 * leaves, sizeof( FreeRun ) );
+    markSpace( 0, n, true );
 
-    len = strlen( hall );
+    // space goes leftmost first until told otherwise, with no free blocks to keep
+    placement = PLACEMENT_LEFTMOST;
+    blockTable = NULL;
+    clearBlocks();
 
-    isSpace = 0;
+    // nobody has any space yet
+    ownerCapacity = 16;
+    ownerCount = 0;
+    owners = ( Owner * )malloc( ownerCapacity * sizeof( Owner ) );
+    for( int i = 0; i < ownerCapacity; i++ ) {
+        owners[ i ].start = -1;
+    }
 }
 
 /** Destroy the monitor, freeing any resources it uses. */
 void destroyMonitor() {
-    // free hall
-    free( hall );
+    // print whatever the log has left
+    if( logMode != LOG_DIRECT ) {
+        stopEventLog();
+    }
 
-    // destroy condition variable
-    pthread_cond_destroy( &cond );
+    // free hall and its index
+    free( bitmap );
+    free( tree );
+    free( owners );
+    free( view );
+    clearBlocks();
+    free( blockTable );
 
     // destroy mutex lock
     pthread_mutex_destroy( &lock );
 }
 
-/** 
-  * Called when an organization wants to reserve the given number
-  * (width) of contiguous spaces in the hall.  Returns the index of
-  * the left-most (lowest-numbered) end of the space allocated to the
-  * organization.
-  * @param name
-  * @param width 
+/**
+  * Give an organization space right now if there is room and the policy lets it have it.
+  * @param name name of the organization
+  * @param width number of spaces to give it, already rounded up by blockWidth
+  * @param asked number of spaces it asked for
+  * @param mover how to tell it its space moved, or NULL if it can't be moved
+  * @return index of the leftmost space it was given, or -1 if it has to wait
 */
-int allocateSpace( char const *name, int width ) {
-    // lock
-    pthread_mutex_lock( &lock );
-    // reset isSpace to keep track of when we have found enough space for an organization
-    isSpace = 0;
-    //
-    int start = 0;
-    // used to count available spaces we find in a row when searching through availableSpaces int array
-    int countAvailable = 0;
-
-    // loop through availableSpaces to determine if we have enough space
-    for( int i = 0; i < len; i++ ) {
-        // if at any point we find the minimum required len = width set found to true
-        // reset countAvailable at any point when we find a char that is not equal to '*'
-        
-        // we found free space!
-        if( hall[ i ] == '*' ) {
-            // if countAvailable is 0 set starting index
-            if( countAvailable == 0 ) {              
-                // leftmost starting index for space to be occupied
-                start = i;
-            }
+static int takeSpace( char const *name, int width, int asked, Mover const *mover ) {
+    // starting index for space to be occupied
+    int start = placeSpace( width );
 
-            //
-            countAvailable++;
+    // even if we fit, the policy may hold the space for someone already waiting
+    if( start != -1 && waiters && policy != POLICY_LEFTMOST ) {
+        long long now = nanoTime();
+        Waiter *front = frontWaiter( now );
+        if( mayPass( width, 0, front, now ) ) {
+            countPass( front );
         }
 
-        // else this space is occupied
         else {
-            // reset countAvailable
-            countAvailable = 0;
+            start = -1;
         }
+    }
 
-        if( countAvailable == width ) {
-            // found required amount of space starting with smallest available index
-            isSpace = 1;
-            //
-            break;
-        }
+    // we have space, take it
+    if( start != -1 ) {
+        occupySpace( name, start, width, mover );
+        report( EVENT_ALLOCATE, name, start, width );
+        stats.allocations++;
+        stats.padding += width - asked;
     }
 
-    // we have space
-    if( isSpace == 1 ){
-        char firstLetter = name[ 0 ];
+    return start;
+}
 
-        for( int i = start; i < start + width; i++ ) {
-            hall[ i ] = firstLetter;
-        }
+/**
+  * Put an organization in line for space, whoever frees the space it needs will hand it over and report it.
+  * @param waiter the organization's place in line
+  * @param name name of the organization
+  * @param width number of spaces it needs, already rounded up by blockWidth
+  * @param mover how to tell it its space moved, or NULL if it can't be moved
+*/
+static void startWaiting( Waiter *waiter, char const *name, int width, Mover const *mover ) {
+    report( EVENT_WAIT, name, -1, width );
 
-        // print allocation message
-        printf( "%s", name );
-        printf( "%s", " allocated: " );
-        printf("%s\n", hall );
-    }
+    waiter->name = name;
+    waiter->width = width;
+    waiter->mover = mover;
+    waiter->ticket = nextTicket++;
+    waiter->since = policy == POLICY_AGING ? nanoTime() : 0;
+    waiter->bypassed = 0;
+    waiter->granted = false;
+    waiter->batch = NULL;
 
-    // we don't have space
-    else {
-        // print waiting message
-        printf( "%s", name );
-        printf( "%s", " waiting: " );
-        printf("%s\n", hall );
-
-        // first letter of name
-        char firstLetter = name[ 0 ];
-        // keep track of when we have actually added the waiting organization to the hall
-        bool isEdited = false;
-
-        // keep looping until we have added the organization
-        while( !isEdited ){
-            // check if we have freed any organizations meaning we have more space to examine
-            while( isSpace == 0 ) {
-                pthread_cond_wait( &cond, &lock );
-            }
+    // deadlines are on the monotonic clock, so setting the time of day can't move them
+    pthread_condattr_t attr;
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_cond_init( &waiter->cond, &attr );
+    pthread_condattr_destroy( &attr );
 
-            // keep track of max number of spaces in a row available
-            int countAvailable = 0;
-            // keep track of starting idx
-            start = 0;
+    addWaiter( waiter );
+    stats.waits++;
+    stats.waiting++;
+}
 
-            // loop through contents of hall
-            for( int i = 0; i < len; i++ ) {
-                if( hall[ i ] == '*' ) {
-                    if( countAvailable == 0 ) {
-                        start = i;
-                    }
+/**
+  * Get space for an organization, waiting for it if we're allowed to.
+  * @param name name of the organization
+  * @param width number of spaces it needs
+  * @param wait false to give up right away if there is no space
+  * @param deadline absolute CLOCK_MONOTONIC time to give up waiting, or NULL to wait as long as it takes
+  * @param mover how to tell it its space moved, or NULL if it can't be moved
+  * @return index of the leftmost space it was given, or -1 if it gave up
+*/
+static int allocate( char const *name, int width, bool wait, struct timespec const *deadline, Mover const *mover ) {
+    // lock
+    lockMonitor();
 
-                    countAvailable++;
-                }
+    // buddy blocks are bigger than what was asked for, we give out and wait for the whole block
+    int asked = width;
+    width = blockWidth( width );
+    int start = takeSpace( name, width, asked, mover );
 
-                else {
-                    countAvailable = 0;
-                }
+    // we don't have space, or the policy is keeping it for someone already waiting
+    if( start == -1 && wait ) {
+        Waiter waiter;
+        startWaiting( &waiter, name, width, mover );
 
-                if( countAvailable == width ) {
-                    break;
-                }
+        bool expired = false;
+        while( !waiter.granted && !expired ) {
+            endHold();
+            if( deadline ) {
+                expired = pthread_cond_timedwait( &waiter.cond, &lock, deadline ) == ETIMEDOUT;
             }
 
-            // if we found enough space break loop after this iteration
-            if( countAvailable == width ) {
-                isEdited = true;
+            else {
+                pthread_cond_wait( &waiter.cond, &lock );
             }
+            startHold();
+            stats.wakeups++;
+        }
 
-            // if we found what we want edit the hall to include waiting organization
-            if( isEdited ) {
-                for( int i = start; i < start + width; i++ ) {
-                    hall[ i ] = firstLetter;
-                }
-            }
+        // space could have been handed to us just as time ran out, then we keep it, wherever it has been moved to
+        if( waiter.granted ) {
+            start = mover ? *mover->where : waiter.start;
+            stats.allocations++;
+            stats.padding += width - asked;
+        }
 
-            // otherwise set isSpace back to zero indicating we don't actually have enough space
-            // this will be switched back to 1 on every call to free method
-            else {
-                isSpace = 0;
+        else {
+            Waiter **head = &waiters;
+            while( ( *head )->width != width ) {
+                head = &( *head )->nextWidth;
             }
+            removeWaiter( head, &waiter );
+            stats.waiting--;
+            report( EVENT_CANCEL, name, -1, width );
+
+            // we may have been the one the policy was holding space for
+            grantWaiters();
         }
 
-        // print allocation message
-        printf( "%s", name );
-        printf( "%s", " allocated: " );
-        printf("%s\n", hall );
+        pthread_cond_destroy( &waiter.cond );
     }
 
     // unlock
-    pthread_mutex_unlock( &lock );
+    unlockMonitor();
     // return leftmost idx
     return start;
 }
 
+/** 
+  * Called when an organization wants to reserve the given number
+  * (width) of contiguous spaces in the hall.  Returns the index of
+  * the left-most (lowest-numbered) end of the space allocated to the
+  * organization.
+  * @param name
+  * @param width 
+*/
+int allocateSpace( char const *name, int width ) {
+    return allocate( name, width, true, NULL, NULL );
+}
+
+int tryAllocateSpace( char const *name, int width ) {
+    return allocate( name, width, false, NULL, NULL );
+}
+
+int allocateSpaceTimed( char const *name, int width, struct timespec const *deadline ) {
+    return allocate( name, width, true, deadline, NULL );
+}
+
+
+/**
+  * Take an organization's space back, in the hall, the owner table, the tree and the free blocks if we keep them.
+  * @param name name of the organization
+  * @param start index of its leftmost space
+  * @param width number of spaces it asked for
+*/
+static void releaseSpace( char const *name, int start, int width ) {
+    // remove passed organization, and the rest of its block if it had one
+    int given = blockWidth( width );
+    stats.padding -= given - width;
+    width = given;
+    removeOwner( start );
+    markSpace( start, width, true );
+    if( placement != PLACEMENT_LEFTMOST ) {
+        returnBlock( start, width );
+    }
+    report( EVENT_FREE, name, start, width );
+}
 
 /** 
   * Release the allocated spaces from index start up to (and including)
@@ -216,23 +1436,181 @@ int allocateSpace( char const *name, int width ) {
 */
 void freeSpace( char const *name, int start, int width ) {
     // lock
-    pthread_mutex_lock( &lock );
+    lockMonitor();
+
+    releaseSpace( name, start, width );
+
+    // the waiters that now fit get their space before anyone else can take it
+    grantWaiters();
+
+    // unlock
+    unlockMonitor();
+}
+
+void allocateMovable( char const *name, int width, int *start, MoveCallback moved, void *arg ) {
+    Mover mover = { start, moved, arg };
+    allocate( name, width, true, NULL, &mover );
+}
+
+void freeMovable( char const *name, int const *start, int width ) {
+    // lock
+    lockMonitor();
+
+    // read under the lock, so a move can't change it under us
+    releaseSpace( name, *start, width );
+    grantWaiters();
+
+    // unlock
+    unlockMonitor();
+}
+
+/**
+  * Comparison function for sorting a batch widest first, keeping the order requests of the same width were given in.
+*/
+static int compareRequests( void const *a, void const *b ) {
+    SpaceRequest const *x = *( SpaceRequest * const * )a;
+    SpaceRequest const *y = *( SpaceRequest * const * )b;
+    if( x->width != y->width ) {
+        return x->width > y->width ? -1 : 1;
+    }
+
+    return x < y ? -1 : x > y;
+}
+
+void allocateBatch( SpaceRequest *requests, int count ) {
+    // widest first, so narrow requests fill in the gaps the wide ones leave instead of breaking up runs they need
+    SpaceRequest **order = ( SpaceRequest ** )malloc( count * sizeof( SpaceRequest * ) );
+    int total = 0;
+    for( int i = 0; i < count; i++ ) {
+        order[ i ] = &requests[ i ];
+        total += blockWidth( requests[ i ].width );
+    }
+    qsort( order, count, sizeof( SpaceRequest * ), compareRequests );
+
+    // lock
+    lockMonitor();
+
+    // the policy may hold the space for someone already waiting, and the batch asks for all of it together. Going
+    // ahead only counts against the front waiter if the batch actually goes
+    Waiter *front = NULL;
+    bool allowed = true;
+    if( waiters && policy != POLICY_LEFTMOST ) {
+        long long now = nanoTime();
+        front = frontWaiter( now );
+        allowed = mayPass( total, 0, front, now );
+    }
+
+    bool placed = allowed && placeBatch( order, count );
+    if( placed && front ) {
+        countPass( front );
+    }
+
+    // wait in line holding nothing, whoever frees enough for the whole batch places it and reports it
+    if( !placed ) {
+        for( int i = 0; i < count; i++ ) {
+            report( EVENT_WAIT, order[ i ]->name, -1, blockWidth( order[ i ]->width ) );
+        }
+
+        Waiter waiter;
+        waiter.name = order[ 0 ]->name;
+        waiter.width = total;
+        waiter.batch = order;
+        waiter.count = count;
+        waiter.ticket = nextTicket++;
+        waiter.granted = false;
+        waiter.next = NULL;
+        pthread_cond_init( &waiter.cond, NULL );
 
-    // remove passed organization
-    for( int i = start; i < start + width; i++ ) {
-        hall[ i ] = '*';
+        Waiter **link = &batchWaiters;
+        while( *link ) {
+            link = &( *link )->next;
+        }
+        *link = &waiter;
+        stats.waits += count;
+        stats.waiting += count;
+
+        while( !waiter.granted ) {
+            endHold();
+            pthread_cond_wait( &waiter.cond, &lock );
+            startHold();
+            stats.wakeups++;
+        }
+
+        pthread_cond_destroy( &waiter.cond );
     }
 
-    // tell allocate we have more space to look at
-    isSpace = 1;
+    // unlock
+    unlockMonitor();
+
+    free( order );
+}
+
+void freeBatch( SpaceRequest const *requests, int count ) {
+    // lock
+    lockMonitor();
+
+    for( int i = 0; i < count; i++ ) {
+        releaseSpace( requests[ i ].name, requests[ i ].start, requests[ i ].width );
+    }
 
-    // print freed message
-    printf( "%s", name );
-    printf("%s", " freed: " );
-    printf("%s\n", hall );
+    // waiters are handed space once, with everything in the batch already free
+    grantWaiters();
 
     // unlock
+    unlockMonitor();
+}
+
+void setAllocationPolicy( int newPolicy, int newBound ) {
+    lockMonitor();
+    policy = newPolicy;
+    bound = newBound;
+    unlockMonitor();
+}
+
+void setPlacement( int newPlacement ) {
+    lockMonitor();
+    clearBlocks();
+    placement = newPlacement;
+
+    // the hall is empty, so it is one free run, or the biggest buddy blocks that fit from left to right
+    if( placement == PLACEMENT_BEST_FIT && len > 0 ) {
+        addBlock( 0, len );
+    }
+
+    else if( placement == PLACEMENT_BUDDY ) {
+        for( int start = 0; start < len; ) {
+            int length = start ? start & -start : 1 << classOf( len );
+            while( start + length > len ) {
+                length /= 2;
+            }
+            addBlock( start, length );
+            start += length;
+        }
+    }
+
+    unlockMonitor();
+}
+
+void setLogMode( int mode ) {
+    lockMonitor();
+
+    // anything already logged is printed before we change how we report
+    if( logMode != LOG_DIRECT ) {
+        stopEventLog();
+    }
+
+    logMode = mode;
+    if( logMode != LOG_DIRECT ) {
+        startEventLog( renderHall(), logMode == LOG_DIFF );
+    }
+
+    unlockMonitor();
+}
+
+void getMonitorStats( MonitorStats *out ) {
+    // not timed, so looking at the counts doesn't change them
+    pthread_mutex_lock( &lock );
+    *out = stats;
+    out->largestFree = tree[ 1 ].best;
     pthread_mutex_unlock( &lock );
-    // signal threads
-    pthread_cond_broadcast( &cond );
 }
\ No newline at end of file
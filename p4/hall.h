@@ -0,0 +1,195 @@
+/**
+  * @file hall.h
+  * @author Jake Donovan (jmpatte8)
+  * Header for the hall monitor, which hands out runs of contiguous spaces in a hall to organizations, making them wait
+  * until there is room.
+*/
+
+#ifndef HALL_H
+#define HALL_H
+
+#include <time.h>
+
+/** Ways the monitor can choose who gets space. POLICY_LEFTMOST gives space to anyone it fits, which can leave a wide
+  * organization waiting forever while narrow ones keep arriving. POLICY_FIFO lets organizations go ahead of the one
+  * that has waited longest only a bounded number of times, and POLICY_AGING lets narrow ones go first until a waiter
+  * has waited long enough for its width.
+*/
+#define POLICY_LEFTMOST 0
+#define POLICY_FIFO 1
+#define POLICY_AGING 2
+
+/** Where the monitor puts the space it gives out. PLACEMENT_LEFTMOST uses the leftmost run of free spaces that fits.
+  * PLACEMENT_BEST_FIT uses the shortest free run that fits, keeping long runs whole for wide organizations.
+  * PLACEMENT_BUDDY rounds each width up to a power of two and gives out aligned blocks, splitting a bigger block in
+  * half as needed and merging a freed block with its buddy.
+*/
+#define PLACEMENT_LEFTMOST 0
+#define PLACEMENT_BEST_FIT 1
+#define PLACEMENT_BUDDY 2
+
+/** Ways the monitor can report what it does. LOG_DIRECT prints each message, with the whole hall, while holding the
+  * lock. LOG_FULL prints the same messages from a background thread, and LOG_DIFF has the background thread print only
+  * the spaces each event changed.
+*/
+#define LOG_DIRECT 0
+#define LOG_FULL 1
+#define LOG_DIFF 2
+
+/** Counts the monitor keeps so a driver or benchmark can see how it is behaving */
+typedef struct {
+    // calls to allocateSpace that have returned
+    long allocations;
+    // calls to allocateSpace that had to wait
+    long waits;
+    // times a waiting organization woke up, including any wakeup that found it still had no space
+    long wakeups;
+    // organizations waiting right now
+    int waiting;
+    // number of times the lock was held, and the total and longest time it was held for, in nanoseconds
+    long lockHolds;
+    long long lockHoldNs;
+    long long maxLockHoldNs;
+    // times a thread found the lock already held and had to wait for it
+    long contended;
+    // free spaces in the hall right now, and the longest run of them
+    int freeSpaces;
+    int largestFree;
+    // spaces given out right now beyond what was asked for, from rounding up to buddy blocks
+    int padding;
+    // times an allocation was moved to bring free space together
+    long moves;
+} MonitorStats;
+
+/**
+  * Called by the monitor, while it holds its lock, after it moves an allocation made with allocateMovable.
+  * @param arg the arg given to allocateMovable
+  * @param from leftmost space it had
+  * @param to leftmost space it has now
+*/
+typedef void ( *MoveCallback )( void *arg, int from, int to );
+
+/** One organization's part of a batch for allocateBatch or freeBatch */
+typedef struct {
+    // name of the organization
+    char const *name;
+    // number of spaces it needs
+    int width;
+    // index of the leftmost space it was given, set by allocateBatch
+    int start;
+} SpaceRequest;
+
+/**
+  * Initialize the monitor as a hall with n spaces that can be partitioned
+  * off.
+  * @param n the number of spaces in hall
+*/
+void initMonitor( int n );
+
+/** Destroy the monitor, freeing any resources it uses. */
+void destroyMonitor();
+
+/**
+  * Called when an organization wants to reserve the given number
+  * (width) of contiguous spaces in the hall.  Returns the index of
+  * the left-most (lowest-numbered) end of the space allocated to the
+  * organization.
+  * @param name name of the organization
+  * @param width number of spaces it needs
+  * @return index of the leftmost space it was given
+*/
+int allocateSpace( char const *name, int width );
+
+/**
+  * Like allocateSpace, but never waits.
+  * @param name name of the organization
+  * @param width number of spaces it needs
+  * @return index of the leftmost space it was given, or -1 if it would have had to wait
+*/
+int tryAllocateSpace( char const *name, int width );
+
+/**
+  * Like allocateSpace, but gives up waiting at the deadline.
+  * @param name name of the organization
+  * @param width number of spaces it needs
+  * @param deadline when to give up, an absolute CLOCK_MONOTONIC time
+  * @return index of the leftmost space it was given, or -1 if the deadline passed first
+*/
+int allocateSpaceTimed( char const *name, int width, struct timespec const *deadline );
+
+/**
+  * Release the allocated spaces from index start up to (and including)
+  * index start + width - 1.
+  * @param name name of the organization
+  * @param start index of its leftmost space
+  * @param width number of spaces it has
+*/
+void freeSpace( char const *name, int start, int width );
+
+/**
+  * Like allocateSpace, but the monitor may move the space later to bring free space together, when some waiter would fit
+  * in the free space but there is no run long enough. The leftmost space is stored in *start, which the monitor changes
+  * whenever it moves the space, so *start and name have to stay valid until the space is freed with freeMovable.
+  * @param name name of the organization
+  * @param width number of spaces it needs
+  * @param start where to store the index of its leftmost space
+  * @param moved called after each move, or NULL
+  * @param arg passed to moved
+*/
+void allocateMovable( char const *name, int width, int *start, MoveCallback moved, void *arg );
+
+/**
+  * Release space from allocateMovable, reading where it is now under the monitor's lock.
+  * @param name name of the organization
+  * @param start where the organization keeps its leftmost space, as given to allocateMovable
+  * @param width number of spaces it has
+*/
+void freeMovable( char const *name, int const *start, int width );
+
+/**
+  * Like calling allocateSpace for each request, but taking the lock once. Requests are placed widest first, which packs
+  * them better than placing them in the order given. The batch is all or nothing: if every request can't be placed
+  * right away it waits in line holding no space, and is placed all at once when there is room for all of it, so
+  * batches waiting on each other's space can't deadlock. Waiting batches are handed space before single organizations,
+  * oldest first. A batch that can't fit in the empty hall waits forever.
+  * @param requests the requests, each one's start is set to where it was put
+  * @param count number of requests
+*/
+void allocateBatch( SpaceRequest *requests, int count );
+
+/**
+  * Like calling freeSpace for each request, but taking the lock once and handing space to waiters once at the end.
+  * @param requests the requests, as filled in by allocateBatch
+  * @param count number of requests
+*/
+void freeBatch( SpaceRequest const *requests, int count );
+
+/**
+  * Choose how the monitor decides who gets space, the default is POLICY_LEFTMOST. Call after initMonitor.
+  * @param policy POLICY_LEFTMOST, POLICY_FIFO or POLICY_AGING
+  * @param bound for POLICY_FIFO, times the longest waiting organization can be passed, and for POLICY_AGING,
+  *        microseconds of waiting that make up for each space of width
+*/
+void setAllocationPolicy( int policy, int bound );
+
+/**
+  * Choose where the monitor puts the space it gives out, the default is PLACEMENT_LEFTMOST. Call after initMonitor,
+  * before any space is allocated.
+  * @param placement PLACEMENT_LEFTMOST, PLACEMENT_BEST_FIT or PLACEMENT_BUDDY
+*/
+void setPlacement( int placement );
+
+/**
+  * Choose how the monitor reports what it does, the default is LOG_DIRECT. Call after initMonitor, destroyMonitor
+  * prints anything still waiting to be printed.
+  * @param mode LOG_DIRECT, LOG_FULL or LOG_DIFF
+*/
+void setLogMode( int mode );
+
+/**
+  * Get a copy of the monitor's counts.
+  * @param stats where to store them
+*/
+void getMonitorStats( MonitorStats *stats );
+
+#endif
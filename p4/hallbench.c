@@ -0,0 +1,189 @@
+/**
+  * @file hallbench.c
+  * @author Jake Donovan (jmpatte8)
+  * Benchmark for how the hall monitor wakes waiting organizations. One organization takes the whole hall, then many
+  * organizations of different widths all ask for space and wait. When the hall is freed they get space, use it
+  * briefly and free it again for a number of rounds. We report how many times a waiting organization was woken per
+  * allocation and how long the monitor's lock was held. The monitor's own messages go to /dev/null while it runs, and
+  * can be printed directly, or through the event log in full or diff form, to see what printing costs under the lock.
+  * Compile with hall.c and eventlog.c.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <string.h>
+#include <pthread.h>
+#include "hall.h"
+
+// Number of organizations when we aren't told otherwise.
+#define DEFAULT_ORGS 1000
+
+// Number of times each organization allocates and frees when we aren't told otherwise.
+#define DEFAULT_ROUNDS 10
+
+// Widest request an organization makes, widths go from 1 up to this.
+#define MAX_WIDTH 8
+
+// Stack size for organization threads, they don't need much and there are a lot of them.
+#define STACK_SIZE ( 64 * 1024 )
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+    fprintf( stderr, "%s\n", message );
+    exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+    fprintf( stderr, "usage: hallbench [<organizations> [<rounds> [<hall-size> [direct|full|diff]]]]\n" );
+    exit( 1 );
+}
+
+/** One organization and what it asks for */
+typedef struct {
+    // name, only the first letter shows in the hall
+    char name[ 16 ];
+    // spaces it asks for each time
+    int width;
+} Org;
+
+/** Number of times each organization allocates and frees */
+static int rounds;
+
+/**
+  * Start routine for each organization, allocating and freeing its space rounds times.
+  * @param arg the organization
+*/
+static void *organization( void *arg ) {
+    Org *org = ( Org * )arg;
+    for( int i = 0; i < rounds; i++ ) {
+        int start = allocateSpace( org->name, org->width );
+        freeSpace( org->name, start, org->width );
+    }
+
+    return NULL;
+}
+
+/**
+  * Seconds elapsed since the given time.
+  * @param start the starting time
+  * @return elapsed seconds
+*/
+static double elapsed( struct timespec *start ) {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return ( now.tv_sec - start->tv_sec ) + ( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
+
+/**
+  * Program starting point. Runs the organizations and prints what the monitor counted.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    int orgs = DEFAULT_ORGS;
+    rounds = DEFAULT_ROUNDS;
+    int size = 0;
+    int mode = LOG_DIRECT;
+    if( argc > 5 || ( argc > 1 && ( sscanf( argv[ 1 ], "%d", &orgs ) != 1 || orgs < 1 ) ) ||
+        ( argc > 2 && ( sscanf( argv[ 2 ], "%d", &rounds ) != 1 || rounds < 1 ) ) ||
+        ( argc > 3 && ( sscanf( argv[ 3 ], "%d", &size ) != 1 || ( size != 0 && size < MAX_WIDTH ) ) ) ) {
+        usage();
+    }
+
+    if( argc > 4 ) {
+        if( strcmp( argv[ 4 ], "full" ) == 0 ) {
+            mode = LOG_FULL;
+        }
+
+        else if( strcmp( argv[ 4 ], "diff" ) == 0 ) {
+            mode = LOG_DIFF;
+        }
+
+        else if( strcmp( argv[ 4 ], "direct" ) != 0 ) {
+            usage();
+        }
+    }
+
+    // by default there is room for about a tenth of the organizations at once
+    if( size == 0 ) {
+        size = orgs * ( MAX_WIDTH + 1 ) / 2 / 10;
+        if( size < MAX_WIDTH ) {
+            size = MAX_WIDTH;
+        }
+    }
+
+    Org *org = ( Org * )malloc( orgs * sizeof( Org ) );
+    pthread_t *thread = ( pthread_t * )malloc( orgs * sizeof( pthread_t ) );
+    if( !org || !thread ) {
+        fail( "Out of memory" );
+    }
+
+    // keep the monitor's messages out of the results
+    fflush( stdout );
+    int saved = dup( STDOUT_FILENO );
+    int devNull = open( "/dev/null", O_WRONLY );
+    if( saved == -1 || devNull == -1 ) {
+        fail( "Can't redirect output" );
+    }
+    dup2( devNull, STDOUT_FILENO );
+    close( devNull );
+
+    initMonitor( size );
+    setLogMode( mode );
+    int blocker = allocateSpace( "Blocker", size );
+
+    pthread_attr_t attr;
+    pthread_attr_init( &attr );
+    pthread_attr_setstacksize( &attr, STACK_SIZE );
+    for( int i = 0; i < orgs; i++ ) {
+        snprintf( org[ i ].name, sizeof( org[ i ].name ), "%c%d", 'a' + i % 26, i );
+        org[ i ].width = 1 + i % MAX_WIDTH;
+        if( pthread_create( &thread[ i ], &attr, organization, &org[ i ] ) != 0 ) {
+            fail( "Can't create thread" );
+        }
+    }
+    pthread_attr_destroy( &attr );
+
+    // wait until every organization is waiting for space
+    MonitorStats stats;
+    do {
+        usleep( 1000 );
+        getMonitorStats( &stats );
+    } while( stats.waiting < orgs );
+    MonitorStats before = stats;
+
+    struct timespec start;
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    freeSpace( "Blocker", blocker, size );
+    for( int i = 0; i < orgs; i++ ) {
+        pthread_join( thread[ i ], NULL );
+    }
+    double seconds = elapsed( &start );
+
+    getMonitorStats( &stats );
+    destroyMonitor();
+
+    fflush( stdout );
+    dup2( saved, STDOUT_FILENO );
+    close( saved );
+
+    // count only what happened after the blocker let go
+    long allocations = stats.allocations - before.allocations;
+    long holds = stats.lockHolds - before.lockHolds;
+    printf( "organizations: %d  rounds: %d  hall: %d spaces\n", orgs, rounds, size );
+    printf( "allocations: %ld  waits: %ld  wakeups: %ld\n", allocations, stats.waits, stats.wakeups );
+    printf( "wakeups per allocation: %.3f\n", ( double ) stats.wakeups / allocations );
+    printf( "lock hold: mean %.2f us  max %.2f us\n", ( stats.lockHoldNs - before.lockHoldNs ) / 1e3 / holds,
+            stats.maxLockHoldNs / 1e3 );
+    printf( "time: %.3f s  allocations/s: %.0f\n", seconds, allocations / seconds );
+
+    free( org );
+    free( thread );
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+  * @file hallload.c
+  * @author Jake Donovan (jmpatte8)
+  * Load driver for the hall monitor's allocation policies. Narrow, medium and wide organizations keep asking for space,
+  * holding it briefly and coming back, for a fixed time under each policy. We report the p50, p99 and longest wait for
+  * space in each width class, so we can see whether the wide ones are starved. The monitor's own messages go to
+  * /dev/null while it runs. Compile with hall.c and eventlog.c.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "hall.h"
+
+// Number of spaces in the hall.
+#define HALL_SIZE 32
+
+// Seconds to run each policy when we aren't told otherwise.
+#define DEFAULT_SECONDS 2
+
+// Bounds for the fair policies when we aren't told otherwise, see setAllocationPolicy.
+#define DEFAULT_BYPASS 8
+#define DEFAULT_AGING 200
+
+// Microseconds an organization holds its space, and waits before asking again.
+#define HOLD_US 200
+#define THINK_US 50
+
+// Number of width classes.
+#define CLASSES 3
+
+// Width of the organizations in each class, and how many of them there are.
+static int const classWidth[ CLASSES ] = { 1, 4, 24 };
+static int const classCount[ CLASSES ] = { 12, 4, 2 };
+
+// Most organizations in all the classes together.
+#define MAX_ORGS 32
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+    fprintf( stderr, "%s\n", message );
+    exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+    fprintf( stderr, "usage: hallload [<seconds-per-policy> [<fifo-bypass> [<aging-us-per-space>]]]\n" );
+    exit( 1 );
+}
+
+/** One organization and the waits it saw */
+typedef struct {
+    // name, only the first letter shows in the hall
+    char name[ 16 ];
+    // spaces it asks for each time
+    int width;
+    // nanoseconds each allocateSpace took
+    long long *waits;
+    // number of waits, and room for them
+    int count;
+    int capacity;
+} Org;
+
+/** Set to tell the organizations to stop asking for space */
+static atomic_bool stop;
+
+/**
+  * Current time in nanoseconds.
+  * @return monotonic clock reading
+*/
+static long long nanoTime() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/** Comparison function for sorting waits. */
+static int compareTimes( void const *a, void const *b ) {
+    long long x = *( long long const * )a;
+    long long y = *( long long const * )b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+  * Start routine for each organization, asking for space until told to stop.
+  * @param arg the organization
+*/
+static void *organization( void *arg ) {
+    Org *org = ( Org * )arg;
+    while( !atomic_load( &stop ) ) {
+        long long asked = nanoTime();
+        int start = allocateSpace( org->name, org->width );
+        long long waited = nanoTime() - asked;
+
+        if( org->count == org->capacity ) {
+            org->capacity = org->capacity ? org->capacity * 2 : 1024;
+            org->waits = ( long long * )realloc( org->waits, org->capacity * sizeof( long long ) );
+            if( !org->waits ) {
+                fail( "Out of memory" );
+            }
+        }
+        org->waits[ org->count++ ] = waited;
+
+        usleep( HOLD_US );
+        freeSpace( org->name, start, org->width );
+        usleep( THINK_US );
+    }
+
+    return NULL;
+}
+
+/**
+  * Run every organization under one policy and print the waits for each width class.
+  * @param label name of the policy
+  * @param policy the policy
+  * @param bound bound for the policy
+  * @param seconds how long to run
+*/
+static void runPolicy( char const *label, int policy, int bound, int seconds ) {
+    Org org[ MAX_ORGS ] = { { .name = { 0 } } };
+    pthread_t thread[ MAX_ORGS ];
+    int orgs = 0;
+    for( int c = 0; c < CLASSES; c++ ) {
+        for( int i = 0; i < classCount[ c ]; i++ ) {
+            snprintf( org[ orgs ].name, sizeof( org[ orgs ].name ), "%c%d", 'A' + c, i );
+            org[ orgs ].width = classWidth[ c ];
+            orgs++;
+        }
+    }
+
+    // keep the monitor's messages out of the results
+    fflush( stdout );
+    int saved = dup( STDOUT_FILENO );
+    int devNull = open( "/dev/null", O_WRONLY );
+    if( saved == -1 || devNull == -1 ) {
+        fail( "Can't redirect output" );
+    }
+    dup2( devNull, STDOUT_FILENO );
+    close( devNull );
+
+    initMonitor( HALL_SIZE );
+    setAllocationPolicy( policy, bound );
+    atomic_store( &stop, false );
+    for( int i = 0; i < orgs; i++ ) {
+        if( pthread_create( &thread[ i ], NULL, organization, &org[ i ] ) != 0 ) {
+            fail( "Can't create thread" );
+        }
+    }
+
+    // once the narrow organizations stop, anyone still waiting gets the empty hall
+    sleep( seconds );
+    atomic_store( &stop, true );
+    for( int i = 0; i < orgs; i++ ) {
+        pthread_join( thread[ i ], NULL );
+    }
+    destroyMonitor();
+
+    fflush( stdout );
+    dup2( saved, STDOUT_FILENO );
+    close( saved );
+
+    int first = 0;
+    for( int c = 0; c < CLASSES; c++ ) {
+        int total = 0;
+        for( int i = first; i < first + classCount[ c ]; i++ ) {
+            total += org[ i ].count;
+        }
+
+        long long *waits = ( long long * )malloc( total * sizeof( long long ) );
+        int n = 0;
+        for( int i = first; i < first + classCount[ c ]; i++ ) {
+            for( int j = 0; j < org[ i ].count; j++ ) {
+                waits[ n++ ] = org[ i ].waits[ j ];
+            }
+            free( org[ i ].waits );
+        }
+
+        qsort( waits, total, sizeof( long long ), compareTimes );
+        printf( "%-9s %6d %10d %12.1f %12.1f %12.1f\n", label, classWidth[ c ], total, waits[ total / 2 ] / 1e3,
+                waits[ ( int )( total * 0.99 ) ] / 1e3, waits[ total - 1 ] / 1e3 );
+        free( waits );
+        first += classCount[ c ];
+    }
+}
+
+/**
+  * Program starting point. Runs the same load under each policy.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    int seconds = DEFAULT_SECONDS;
+    int bypass = DEFAULT_BYPASS;
+    int aging = DEFAULT_AGING;
+    if( argc > 4 || ( argc > 1 && ( sscanf( argv[ 1 ], "%d", &seconds ) != 1 || seconds < 1 ) ) ||
+        ( argc > 2 && ( sscanf( argv[ 2 ], "%d", &bypass ) != 1 || bypass < 0 ) ) ||
+        ( argc > 3 && ( sscanf( argv[ 3 ], "%d", &aging ) != 1 || aging < 0 ) ) ) {
+        usage();
+    }
+
+    printf( "hall: %d spaces  seconds per policy: %d  fifo bypass: %d  aging: %d us per space\n", HALL_SIZE,
+            seconds, bypass, aging );
+    printf( "%-9s %6s %10s %12s %12s %12s\n", "policy", "width", "allocs", "p50 us", "p99 us", "max us" );
+    runPolicy( "leftmost", POLICY_LEFTMOST, 0, seconds );
+    runPolicy( "fifo", POLICY_FIFO, bypass, seconds );
+    runPolicy( "aging", POLICY_AGING, aging, seconds );
+    return 0;
+}
@@ -0,0 +1,412 @@
+/**
+  * @file hallstress.c
+  * @author Jake Donovan (jmpatte8)
+  * Stress driver for the hall monitor. A number of organization threads keep asking for space, holding it for a while
+  * and freeing it, for a fixed time. Widths come from a range (a random width each time) or a list (each organization
+  * takes the next width in the list). With -m their space is movable, so the monitor can compact the hall when a waiter
+  * is stuck behind fragmentation. We report allocations per second, the mean, p99, p99.9 and longest wait for space, how
+  * fragmented the free space was, how much was given out past what was asked for, and how often the monitor's lock was
+  * contended. Running the same options with each placement compares them under the same workload. The monitor's own messages go to
+  * /dev/null unless -v is given. Compile with hall.c and eventlog.c.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "hall.h"
+
+// Most widths in a width list.
+#define MAX_WIDTHS 32
+
+// Microseconds between samples of the hall's free space.
+#define SAMPLE_US 1000
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+    fprintf( stderr, "%s\n", message );
+    exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+    fprintf( stderr, "usage: hallstress [-o organizations] [-w min-max | -w w1,w2,...] [-h hold-us] [-s hall-size]\n" );
+    fprintf( stderr, "                  [-t seconds] [-p leftmost|fifo|aging] [-b bound] [-f leftmost|best|buddy] [-m] [-v]\n" );
+    exit( 1 );
+}
+
+/** How widths are chosen */
+typedef struct {
+    // true for a random width from min to max each time, false for a fixed width from the list per organization
+    bool range;
+    int min, max;
+    // the list, and the number of widths in it
+    int list[ MAX_WIDTHS ];
+    int count;
+} WidthSpec;
+
+/** One organization and what it saw */
+typedef struct {
+    // name, only the first letter shows in the hall
+    char name[ 16 ];
+    // width it always asks for, or 0 for a random one each time
+    int width;
+    // seed for its random widths
+    unsigned seed;
+    // allocations it made, and the total and longest time it waited for them in nanoseconds
+    long allocations;
+    long long waitNs;
+    long long maxWaitNs;
+    // every wait, and room for them
+    long long *waits;
+    long capacity;
+} Org;
+
+/** How widths are chosen */
+static WidthSpec widths = { true, 1, 8, { 0 }, 0 };
+
+/** Microseconds an organization holds its space */
+static int holdUs = 100;
+
+/** True if organizations ask for space the monitor can move */
+static bool movable;
+
+/** Set to tell the organizations to stop asking for space */
+static atomic_bool stop;
+
+/**
+  * Current time in nanoseconds.
+  * @return monotonic clock reading
+*/
+static long long nanoTime() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/** Comparison function for sorting waits. */
+static int compareTimes( void const *a, void const *b ) {
+    long long x = *( long long const * )a;
+    long long y = *( long long const * )b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+  * Read a width range like 1-8 or a width list like 1,4,24.
+  * @param arg the option value
+  * @param spec where to store it
+  * @return true if it was valid
+*/
+static bool parseWidths( char const *arg, WidthSpec *spec ) {
+    int min, max, n;
+    if( sscanf( arg, "%d-%d%n", &min, &max, &n ) == 2 && arg[ n ] == '\0' ) {
+        spec->range = true;
+        spec->min = min;
+        spec->max = max;
+        return min >= 1 && max >= min;
+    }
+
+    spec->range = false;
+    spec->count = 0;
+    while( *arg ) {
+        if( spec->count == MAX_WIDTHS || sscanf( arg, "%d%n", &spec->list[ spec->count ], &n ) != 1 ||
+            spec->list[ spec->count ] < 1 ) {
+            return false;
+        }
+
+        spec->count++;
+        arg += n;
+        if( *arg == ',' ) {
+            arg++;
+        }
+
+        else if( *arg ) {
+            return false;
+        }
+    }
+
+    return spec->count > 0;
+}
+
+/**
+  * Start routine for each organization, asking for space until told to stop.
+  * @param arg the organization
+*/
+static void *organization( void *arg ) {
+    Org *org = ( Org * )arg;
+    while( !atomic_load( &stop ) ) {
+        int width = org->width;
+        if( width == 0 ) {
+            width = widths.min + rand_r( &org->seed ) % ( widths.max - widths.min + 1 );
+        }
+
+        // the monitor keeps start up to date if it moves our space
+        long long asked = nanoTime();
+        int start;
+        if( movable ) {
+            allocateMovable( org->name, width, &start, NULL, NULL );
+        }
+
+        else {
+            start = allocateSpace( org->name, width );
+        }
+        long long waited = nanoTime() - asked;
+
+        if( org->allocations == org->capacity ) {
+            org->capacity = org->capacity ? org->capacity * 2 : 1024;
+            org->waits = ( long long * )realloc( org->waits, org->capacity * sizeof( long long ) );
+            if( !org->waits ) {
+                fail( "Out of memory" );
+            }
+        }
+        org->waits[ org->allocations++ ] = waited;
+        org->waitNs += waited;
+        if( waited > org->maxWaitNs ) {
+            org->maxWaitNs = waited;
+        }
+
+        if( holdUs > 0 ) {
+            usleep( holdUs );
+        }
+
+        if( movable ) {
+            freeMovable( org->name, &start, width );
+        }
+
+        else {
+            freeSpace( org->name, start, width );
+        }
+    }
+
+    return NULL;
+}
+
+/**
+  * Program starting point. Runs the organizations and prints what we and the monitor counted.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    int orgs = 16;
+    int size = 64;
+    int seconds = 2;
+    int policy = POLICY_LEFTMOST;
+    int bound = 8;
+    int placement = PLACEMENT_LEFTMOST;
+    bool verbose = false;
+
+    for( int i = 1; i < argc; i++ ) {
+        if( strcmp( argv[ i ], "-v" ) == 0 ) {
+            verbose = true;
+            continue;
+        }
+
+        if( strcmp( argv[ i ], "-m" ) == 0 ) {
+            movable = true;
+            continue;
+        }
+
+        // every other option takes a value
+        if( i + 1 >= argc || argv[ i ][ 0 ] != '-' || strlen( argv[ i ] ) != 2 ) {
+            usage();
+        }
+
+        char const *value = argv[ ++i ];
+        switch( argv[ i - 1 ][ 1 ] ) {
+            case 'o':
+                if( sscanf( value, "%d", &orgs ) != 1 || orgs < 1 )
+                    usage();
+                break;
+            case 'w':
+                if( !parseWidths( value, &widths ) )
+                    usage();
+                break;
+            case 'h':
+                if( sscanf( value, "%d", &holdUs ) != 1 || holdUs < 0 )
+                    usage();
+                break;
+            case 's':
+                if( sscanf( value, "%d", &size ) != 1 || size < 1 )
+                    usage();
+                break;
+            case 't':
+                if( sscanf( value, "%d", &seconds ) != 1 || seconds < 1 )
+                    usage();
+                break;
+            case 'p':
+                if( strcmp( value, "leftmost" ) == 0 )
+                    policy = POLICY_LEFTMOST;
+                else if( strcmp( value, "fifo" ) == 0 )
+                    policy = POLICY_FIFO;
+                else if( strcmp( value, "aging" ) == 0 )
+                    policy = POLICY_AGING;
+                else
+                    usage();
+                break;
+            case 'b':
+                if( sscanf( value, "%d", &bound ) != 1 || bound < 0 )
+                    usage();
+                break;
+            case 'f':
+                if( strcmp( value, "leftmost" ) == 0 )
+                    placement = PLACEMENT_LEFTMOST;
+                else if( strcmp( value, "best" ) == 0 )
+                    placement = PLACEMENT_BEST_FIT;
+                else if( strcmp( value, "buddy" ) == 0 )
+                    placement = PLACEMENT_BUDDY;
+                else
+                    usage();
+                break;
+            default:
+                usage();
+        }
+    }
+
+    // a width that can never fit would wait forever
+    int widest = widths.max;
+    for( int i = 0; !widths.range && i < widths.count; i++ ) {
+        widest = i == 0 || widths.list[ i ] > widest ? widths.list[ i ] : widest;
+    }
+    if( placement == PLACEMENT_BUDDY ) {
+        // rounded up to a buddy block, which has to fit in the biggest block at the left end of the hall
+        int block = 1;
+        while( block < widest ) {
+            block *= 2;
+        }
+
+        int largest = 1;
+        while( largest * 2 <= size ) {
+            largest *= 2;
+        }
+        widest = block > largest ? size + 1 : block;
+    }
+    if( widest > size ) {
+        fail( "Every width has to fit in the hall" );
+    }
+
+    Org *org = ( Org * )calloc( orgs, sizeof( Org ) );
+    pthread_t *thread = ( pthread_t * )malloc( orgs * sizeof( pthread_t ) );
+    if( !org || !thread ) {
+        fail( "Out of memory" );
+    }
+
+    for( int i = 0; i < orgs; i++ ) {
+        snprintf( org[ i ].name, sizeof( org[ i ].name ), "%c%d", 'A' + i % 26, i );
+        org[ i ].width = widths.range ? 0 : widths.list[ i % widths.count ];
+        org[ i ].seed = i + 1;
+    }
+
+    // keep the monitor's messages out of the results unless we were asked for them
+    fflush( stdout );
+    int saved = dup( STDOUT_FILENO );
+    if( !verbose ) {
+        int devNull = open( "/dev/null", O_WRONLY );
+        if( saved == -1 || devNull == -1 ) {
+            fail( "Can't redirect output" );
+        }
+        dup2( devNull, STDOUT_FILENO );
+        close( devNull );
+    }
+
+    initMonitor( size );
+    setAllocationPolicy( policy, bound );
+    setPlacement( placement );
+    atomic_store( &stop, false );
+
+    long long start = nanoTime();
+    for( int i = 0; i < orgs; i++ ) {
+        if( pthread_create( &thread[ i ], NULL, organization, &org[ i ] ) != 0 ) {
+            fail( "Can't create thread" );
+        }
+    }
+
+    // fragmentation is the share of free space that isn't in the longest free run, and padding the share of occupied
+    // space nobody asked for, sampled while we run
+    double fragmentation = 0, padding = 0;
+    long samples = 0, occupiedSamples = 0;
+    long long end = start + seconds * 1000000000LL;
+    while( nanoTime() < end ) {
+        usleep( SAMPLE_US );
+        MonitorStats stats;
+        getMonitorStats( &stats );
+        if( stats.freeSpaces > 0 ) {
+            fragmentation += 1.0 - ( double ) stats.largestFree / stats.freeSpaces;
+            samples++;
+        }
+
+        if( stats.freeSpaces < size ) {
+            padding += ( double ) stats.padding / ( size - stats.freeSpaces );
+            occupiedSamples++;
+        }
+    }
+
+    atomic_store( &stop, true );
+    for( int i = 0; i < orgs; i++ ) {
+        pthread_join( thread[ i ], NULL );
+    }
+    double elapsed = ( nanoTime() - start ) / 1e9;
+
+    MonitorStats stats;
+    getMonitorStats( &stats );
+    destroyMonitor();
+
+    fflush( stdout );
+    dup2( saved, STDOUT_FILENO );
+    close( saved );
+
+    long allocations = 0;
+    long long waitNs = 0, maxWaitNs = 0;
+    for( int i = 0; i < orgs; i++ ) {
+        allocations += org[ i ].allocations;
+        waitNs += org[ i ].waitNs;
+        if( org[ i ].maxWaitNs > maxWaitNs ) {
+            maxWaitNs = org[ i ].maxWaitNs;
+        }
+    }
+
+    long long *waits = ( long long * )malloc( allocations * sizeof( long long ) );
+    long n = 0;
+    for( int i = 0; i < orgs; i++ ) {
+        for( long j = 0; j < org[ i ].allocations; j++ ) {
+            waits[ n++ ] = org[ i ].waits[ j ];
+        }
+        free( org[ i ].waits );
+    }
+    qsort( waits, allocations, sizeof( long long ), compareTimes );
+
+    char const *placementName[] = { "leftmost", "best", "buddy" };
+    if( widths.range ) {
+        printf( "organizations: %d  widths: %d-%d  hold: %d us  hall: %d spaces  placement: %s  time: %.2f s\n", orgs,
+                widths.min, widths.max, holdUs, size, placementName[ placement ], elapsed );
+    }
+
+    else {
+        printf( "organizations: %d  widths: %d listed  hold: %d us  hall: %d spaces  placement: %s  time: %.2f s\n",
+                orgs, widths.count, holdUs, size, placementName[ placement ], elapsed );
+    }
+
+    printf( "allocations: %ld  allocations/s: %.0f\n", allocations, allocations / elapsed );
+    printf( "wait: mean %.1f us  p99 %.1f us  p99.9 %.1f us  max %.1f us  waited: %.1f%% of allocations\n",
+            waitNs / 1e3 / allocations, waits[ ( long )( allocations * 0.99 ) ] / 1e3,
+            waits[ ( long )( allocations * 0.999 ) ] / 1e3, maxWaitNs / 1e3, 100.0 * stats.waits / allocations );
+    printf( "fragmentation: mean %.3f over %ld samples  padding: mean %.3f\n", samples ? fragmentation / samples : 0.0,
+            samples, occupiedSamples ? padding / occupiedSamples : 0.0 );
+    printf( "lock: %ld holds  %.1f%% contended  mean hold %.2f us  max hold %.1f us\n", stats.lockHolds,
+            100.0 * stats.contended / stats.lockHolds, stats.lockHoldNs / 1e3 / stats.lockHolds,
+            stats.maxLockHoldNs / 1e3 );
+    if( movable ) {
+        printf( "moves: %ld  per allocation: %.3f\n", stats.moves, ( double ) stats.moves / allocations );
+    }
+
+    free( waits );
+
+    free( org );
+    free( thread );
+    return 0;
+}
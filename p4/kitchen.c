@@ -0,0 +1,1168 @@
+/**
+  * @file kitchen.c
+  * @author Jake Donovan (jmpatte8)
+  * This file is responsible for running our kitchen from a table of chefs, where each chef has a name, a number of
+  * milliseconds to cook a dish and the set of appliances it needs, kept as a bitmask. Every chef runs the same routine,
+  * and how chefs get their appliances without deadlocking is a mode chosen on the command line:
+  *   global  -> one mutex lock for cooking, so only one chef cooks at a time
+  *   ordered -> a mutex lock for each appliance, always locked in alphabetical order so there is no circular wait
+  *   takeAll -> no hold and wait, a chef takes all of its appliances at once under a mutex lock and condition variable
+  *   atomic  -> also takes them all at once, but with one compare and swap on a word of free appliances, and only waits
+  *              on a futex when they aren't all free
+  *   targeted-> also takes them all at once, but a chef that has to wait sleeps on its own condition variable, and
+  *              whoever gives back appliances it needs hands it the whole set once it's free, waking only that chef.
+  *              Which waiting chef goes first is a policy chosen with -p, so chefs needing several appliances
+  *              aren't starved by chefs needing fewer
+  * The chefs are our usual ten unless we're given a file with a chef on each line ( name, milliseconds, appliances ), or
+  * asked to make up a kitchen with any number of chefs and appliances for capacity studies. With -s the same kitchen
+  * runs as a discrete event simulation in virtual time instead of with threads and sleeps, so a run takes milliseconds
+  * and we can average over many seeds. Compile with -pthread and -lm.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Most appliances a kitchen can have, and the words it takes to hold a bitmask of them.
+#define MAX_APPLIANCES 256
+#define MASK_WORDS ( MAX_APPLIANCES / 64 )
+
+// Longest name for a chef or an appliance, and longest line in a kitchen file.
+#define NAME_LIMIT 25
+#define LINE_LIMIT 4096
+
+// How a mode gets appliances, as far as the simulation is concerned: one lock for everything, a lock for each
+// appliance taken in order, or all of them at once.
+#define MODEL_GLOBAL 0
+#define MODEL_ORDERED 1
+#define MODEL_ALL 2
+
+// Ways to choose which waiting chef gets its appliances in targeted. POLICY_GREEDY hands them to the oldest waiter
+// that can use them, which can leave a chef needing several appliances waiting while chefs needing fewer keep taking
+// them. POLICY_FIFO hands out tickets and lets chefs go ahead of the longest waiter, when they need some of the same
+// appliances, only a bounded number of times. POLICY_AGING lets chefs needing fewer appliances go first until a waiter
+// has waited long enough for how many it needs. POLICY_SHORTEST lets the chef with the shortest cook time go first,
+// with the same bound on passing the longest waiter as POLICY_FIFO.
+#define POLICY_GREEDY 0
+#define POLICY_FIFO 1
+#define POLICY_AGING 2
+#define POLICY_SHORTEST 3
+
+// Kinds of events in the simulation.
+#define DONE_COOKING 0
+#define DONE_RESTING 1
+
+/** A little record used to keep up with each of our threads. */
+typedef struct ChefRecStruct {
+  // Thread handle for this chef.
+  pthread_t thread;
+
+  // Name for this chef.
+  char name[ NAME_LIMIT ];
+
+  // Milliseconds this chef needs to prepare a dish.
+  int cookTime;
+
+  // Appliances this chef uses, as a bitmask and as a list in alphabetical order.
+  uint64_t need[ MASK_WORDS ];
+  int uses[ MAX_APPLIANCES ];
+  int useCount;
+
+  // Seed for this chef's cooking and resting times.
+  unsigned seed;
+
+  // Number of dishes prepared by this chef.
+  int dishCount;
+
+  // Times this chef was woken while waiting for appliances, and how many of those found them still busy.
+  int wakeups;
+  int spurious;
+
+  // For targeted, signaled only when this chef is handed its appliances, and the next chef waiting after it.
+  pthread_cond_t cond;
+  bool granted;
+  struct ChefRecStruct *next;
+
+  // For targeted, its place in line, when it started waiting in microseconds, and times it has been passed.
+  long ticket;
+  long long since;
+  int bypassed;
+} ChefRec;
+
+/** One way of getting and giving back a chef's appliances. */
+typedef struct {
+  // Name we choose it by on the command line.
+  char const *name;
+
+  // Get everything the chef needs, waiting if we have to, then give it all back.
+  void ( *acquire )( ChefRec *chef );
+  void ( *release )( ChefRec *chef );
+
+  // True if chefs in this mode count their wakeups.
+  bool counted;
+
+  // How the simulation models it.
+  int model;
+} Mode;
+
+/** Something that happens to a chef at a moment in virtual time. */
+typedef struct {
+  // Microseconds since the start.
+  long long time;
+
+  // Tie breaker, so events at the same time happen in the order they were scheduled.
+  long order;
+
+  // Index of the chef and what it just finished.
+  int chef;
+  int kind;
+} Event;
+
+/** To tell all the chefs when they can quit running. */
+static bool running = true;
+
+/** True if chefs print when they cook and rest. */
+static bool verbose = true;
+
+/** Milliseconds a chef rests between dishes. */
+static int restTime = 25;
+
+/** Our chefs, and how many there are. */
+static ChefRec *chefList;
+static int chefCount;
+
+/** Names of our appliances, in alphabetical order, and how many there are. */
+static char applianceName[ MAX_APPLIANCES ][ NAME_LIMIT ];
+static int applianceCount;
+
+/** Our usual ten chefs, written the way they would be in a kitchen file. */
+static char const *const defaultKitchen[] = {
+  "Mandy 105 coffeeMaker microwave",
+  "Edmund 30 blender mixer oven",
+  "Napoleon 60 blender grill",
+  "Prudence 15 coffeeMaker griddle microwave",
+  "Kyle 45 fryer oven",
+  "Claire 15 griddle grill",
+  "Lucia 15 griddle mixer",
+  "Marcos 60 blender fryer microwave",
+  "Roslyn 75 fryer grill",
+  "Stephenie 30 coffeeMaker mixer oven",
+};
+
+/** Print out an error message and exit. */
+static void fail( char const *message ) {
+  fprintf( stderr, "%s\n", message );
+  exit( 1 );
+}
+
+/** Print out a usage message and exit. */
+static void usage() {
+  fprintf( stderr, "usage: kitchen [-m global|ordered|takeAll|atomic|targeted] [-f kitchen-file | -g chefs appliances per-chef]\n" );
+  fprintf( stderr, "               [-p greedy|fifo|aging|shortest [-b bound]] [-t seconds] [-r rest-ms] [-q]\n" );
+  fprintf( stderr, "               [-s [-n runs]] [-S seed]\n" );
+  exit( 1 );
+}
+
+/** Pick how many microseconds a chef spends on something that takes about the given number of milliseconds, between
+    duration / 2 and duration ms. */
+static long pickTime( int duration, ChefRec *chef )
+{
+  return 500 * ( (long) rand_r( &chef->seed ) * duration / RAND_MAX + duration  );
+}
+
+/** Called by a chef after they have locked all the required appliances
+    and are ready to cook for about the given number of milliseconds. */
+static void cook( int duration, ChefRec *chef )
+{
+  if ( verbose )
+    printf( "%s is cooking\n", chef->name );
+  usleep( pickTime( duration, chef ) );
+  chef->dishCount++;
+}
+
+/** Called by a chef between dishes, to let them rest about the given
+    number of milliseconds before cooking another dish. */
+static void rest( int duration, ChefRec *chef )
+{
+  if ( verbose )
+    printf( "%s is resting\n", chef->name );
+  usleep( pickTime( duration, chef ) );
+}
+
+/** Our mutex lock to control which chef is allowed to cook at a time, for global */
+static pthread_mutex_t cooking = PTHREAD_MUTEX_INITIALIZER;
+
+/** A mutex lock for each appliance, for ordered */
+static pthread_mutex_t applianceLock[ MAX_APPLIANCES ];
+
+/** Mutex lock for changing which appliances are free, and condition variable to wait for them, for takeAll */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+/** Appliances nobody is using right now, for takeAll */
+static uint64_t freeMask[ MASK_WORDS ];
+
+/** Only one chef cooks at a time. */
+static void globalAcquire( ChefRec *chef )
+{
+  (void) chef;
+  pthread_mutex_lock( &cooking );
+}
+
+static void globalRelease( ChefRec *chef )
+{
+  (void) chef;
+  pthread_mutex_unlock( &cooking );
+}
+
+/** Lock each appliance in alphabetical order, so no two chefs can each hold one the other needs. */
+static void orderedAcquire( ChefRec *chef )
+{
+  for ( int i = 0; i < chef->useCount; i++ )
+    pthread_mutex_lock( &applianceLock[ chef->uses[ i ] ] );
+}
+
+static void orderedRelease( ChefRec *chef )
+{
+  for ( int i = chef->useCount - 1; i >= 0; i-- )
+    pthread_mutex_unlock( &applianceLock[ chef->uses[ i ] ] );
+}
+
+/**
+  * Check if every appliance a chef needs is free.
+  * @param chef the chef
+  * @return true if it can take them all
+*/
+static bool allFree( ChefRec *chef )
+{
+  for ( int w = 0; w < MASK_WORDS; w++ )
+    if ( chef->need[ w ] & ~freeMask[ w ] )
+      return false;
+
+  return true;
+}
+
+/** Wait until every appliance the chef needs is free, then take them all at once. */
+static void takeAllAcquire( ChefRec *chef )
+{
+  pthread_mutex_lock( &lock );
+  while ( !allFree( chef ) ) {
+    pthread_cond_wait( &cond, &lock );
+    chef->wakeups++;
+    if ( !allFree( chef ) )
+      chef->spurious++;
+  }
+
+  // put them in use
+  for ( int w = 0; w < MASK_WORDS; w++ )
+    freeMask[ w ] &= ~chef->need[ w ];
+  pthread_mutex_unlock( &lock );
+}
+
+static void takeAllRelease( ChefRec *chef )
+{
+  // we are done cooking, release all appliances and let everyone waiting check again
+  pthread_mutex_lock( &lock );
+  for ( int w = 0; w < MASK_WORDS; w++ )
+    freeMask[ w ] |= chef->need[ w ];
+  pthread_cond_broadcast( &cond );
+  pthread_mutex_unlock( &lock );
+}
+
+/** Appliances nobody is using right now, a bit for each, for atomic */
+static _Atomic uint64_t freeWord;
+
+/** Bumped every time appliances are given back, chefs that can't get theirs sleep on it as a futex, for atomic */
+static atomic_int freeCount;
+
+/** Chefs sleeping on freeCount, so giving appliances back only makes a system call when someone is */
+static atomic_int sleepers;
+
+/**
+  * Try to take every appliance a chef needs in one compare and swap.
+  * @param need the chef's appliances
+  * @return true if it got them
+*/
+static bool tryTakeAll( uint64_t need )
+{
+  uint64_t expected = atomic_load( &freeWord );
+  while ( ( expected & need ) == need )
+    if ( atomic_compare_exchange_weak( &freeWord, &expected, expected & ~need ) )
+      return true;
+
+  return false;
+}
+
+/** Take the chef's appliances if they're all free, otherwise sleep until someone gives some back and try again. */
+static void atomicAcquire( ChefRec *chef )
+{
+  if ( tryTakeAll( chef->need[ 0 ] ) )
+    return;
+
+  atomic_fetch_add( &sleepers, 1 );
+  bool woke = false;
+  for ( ;; ) {
+    // read the count before trying, if anything is given back after our try, the futex won't let us sleep
+    int seen = atomic_load( &freeCount );
+    if ( tryTakeAll( chef->need[ 0 ] ) )
+      break;
+    if ( woke )
+      chef->spurious++;
+    woke = syscall( SYS_futex, &freeCount, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0 ) == 0;
+    if ( woke )
+      chef->wakeups++;
+  }
+  atomic_fetch_sub( &sleepers, 1 );
+}
+
+static void atomicRelease( ChefRec *chef )
+{
+  atomic_fetch_or( &freeWord, chef->need[ 0 ] );
+  atomic_fetch_add( &freeCount, 1 );
+  if ( atomic_load( &sleepers ) > 0 )
+    syscall( SYS_futex, &freeCount, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0 );
+}
+
+/** Oldest and newest chefs waiting for their appliances, for targeted */
+static ChefRec *waiters;
+static ChefRec *lastWaiter;
+
+/** Ticket for the next chef to get in line */
+static long nextTicket;
+
+/** How we choose which waiting chef gets its appliances, and the bound that goes with it, for targeted */
+static int policy = POLICY_GREEDY;
+static int bound = 4;
+
+/**
+  * Current time in microseconds.
+  * @return monotonic clock reading
+*/
+static long long microTime()
+{
+  struct timespec now;
+  clock_gettime( CLOCK_MONOTONIC, &now );
+  return now.tv_sec * 1000000LL + now.tv_nsec / 1000;
+}
+
+/**
+  * Put a chef's appliances in use, or back.
+  * @param chef the chef
+  * @param inUse true to take them, false to give them back
+*/
+static void markAppliances( ChefRec *chef, bool inUse )
+{
+  for ( int w = 0; w < MASK_WORDS; w++ )
+    if ( inUse )
+      freeMask[ w ] &= ~chef->need[ w ];
+    else
+      freeMask[ w ] |= chef->need[ w ];
+}
+
+/**
+  * Check if two chefs need any of the same appliances.
+  * @param a a chef
+  * @param b another chef
+  * @return true if they do
+*/
+static bool conflicts( ChefRec *a, ChefRec *b )
+{
+  for ( int w = 0; w < MASK_WORDS; w++ )
+    if ( a->need[ w ] & b->need[ w ] )
+      return true;
+
+  return false;
+}
+
+/**
+  * How urgently a chef should get its appliances under POLICY_AGING. Chefs needing fewer appliances start ahead, and
+  * every waiter gains on them as it waits, bound milliseconds of waiting make up for one appliance.
+  * @param chef the chef
+  * @param waited microseconds it has waited, 0 for one that just arrived
+  * @return priority, higher goes first
+*/
+static long long priority( ChefRec *chef, long long waited )
+{
+  return waited - (long long) chef->useCount * bound * 1000;
+}
+
+/**
+  * Check whether one waiting chef goes before another when both can have their appliances.
+  * @param a a chef
+  * @param b another chef
+  * @param now current time in microseconds
+  * @return true if a goes first
+*/
+static bool ahead( ChefRec *a, ChefRec *b, long long now )
+{
+  if ( policy == POLICY_AGING ) {
+    long long pa = priority( a, now - a->since );
+    long long pb = priority( b, now - b->since );
+    if ( pa != pb )
+      return pa > pb;
+  }
+
+  if ( policy == POLICY_SHORTEST && a->cookTime != b->cookTime )
+    return a->cookTime < b->cookTime;
+
+  return a->ticket < b->ticket;
+}
+
+/**
+  * Find the chef the policy protects, the one that has waited longest or, under POLICY_AGING, the one with the highest
+  * priority.
+  * @param now current time in microseconds
+  * @return the front waiter, or NULL if nobody is waiting
+*/
+static ChefRec *frontWaiter( long long now )
+{
+  ChefRec *front = waiters;
+  for ( ChefRec *waiter = waiters; waiter; waiter = waiter->next )
+    if ( policy == POLICY_AGING ?
+         priority( waiter, now - waiter->since ) > priority( front, now - front->since ) :
+         waiter->ticket < front->ticket )
+      front = waiter;
+
+  return front;
+}
+
+/**
+  * Check whether a chef may take appliances ahead of the front waiter. Chefs that don't need any of the same
+  * appliances always can, since they don't hold it up. Under POLICY_FIFO and POLICY_SHORTEST the front waiter can be
+  * passed bound times, and under POLICY_AGING only by chefs with at least its priority.
+  * @param chef the chef
+  * @param waited microseconds it has waited, 0 for one that just arrived
+  * @param front the front waiter
+  * @param now current time in microseconds
+  * @return true if it may go
+*/
+static bool mayPass( ChefRec *chef, long long waited, ChefRec *front, long long now )
+{
+  if ( policy == POLICY_GREEDY || !front || chef == front || !conflicts( chef, front ) )
+    return true;
+
+  if ( policy == POLICY_AGING )
+    return priority( chef, waited ) >= priority( front, now - front->since );
+
+  return front->bypassed < bound;
+}
+
+/**
+  * Give a chef its appliances, counting it against the front waiter if it went ahead of it.
+  * @param chef the chef
+  * @param front the front waiter, or NULL
+*/
+static void takeAppliances( ChefRec *chef, ChefRec *front )
+{
+  if ( front && chef != front && conflicts( chef, front ) )
+    front->bypassed++;
+  markAppliances( chef, true );
+}
+
+/**
+  * Give a chef that just arrived its appliances right now, if they're all free and the policy lets it have them.
+  * @param chef the chef
+  * @param now current time in microseconds
+  * @return true if it got them
+*/
+static bool takeNow( ChefRec *chef, long long now )
+{
+  // anyone waiting that the policy would let have what's free would have been handed it already
+  if ( !allFree( chef ) )
+    return false;
+
+  ChefRec *front = policy == POLICY_GREEDY ? NULL : frontWaiter( now );
+  if ( !mayPass( chef, 0, front, now ) )
+    return false;
+
+  takeAppliances( chef, front );
+  return true;
+}
+
+/**
+  * Put a chef at the end of the line.
+  * @param chef the chef
+  * @param now current time in microseconds
+*/
+static void getInLine( ChefRec *chef, long long now )
+{
+  chef->granted = false;
+  chef->ticket = nextTicket++;
+  chef->since = now;
+  chef->bypassed = 0;
+  chef->next = NULL;
+  if ( lastWaiter )
+    lastWaiter->next = chef;
+  else
+    waiters = chef;
+  lastWaiter = chef;
+}
+
+/**
+  * Hand appliances to waiting chefs, the one the policy puts first among those that can have them, until nobody left
+  * can.
+  * @param now current time in microseconds
+  * @param granted called for each chef once it has its appliances
+*/
+static void grantWaiters( long long now, void ( *granted )( ChefRec *chef, long long now ) )
+{
+  for ( ;; ) {
+    ChefRec *front = policy == POLICY_GREEDY ? NULL : frontWaiter( now );
+    ChefRec *pickPrev = NULL, *pick = NULL;
+    for ( ChefRec *prev = NULL, *waiter = waiters; waiter; prev = waiter, waiter = waiter->next )
+      if ( allFree( waiter ) && mayPass( waiter, now - waiter->since, front, now ) &&
+           ( !pick || ahead( waiter, pick, now ) ) ) {
+        pickPrev = prev;
+        pick = waiter;
+      }
+
+    if ( !pick )
+      break;
+
+    // take it out of line
+    if ( pickPrev )
+      pickPrev->next = pick->next;
+    else
+      waiters = pick->next;
+    if ( lastWaiter == pick )
+      lastWaiter = pickPrev;
+
+    takeAppliances( pick, front );
+    pick->granted = true;
+    granted( pick, now );
+  }
+}
+
+/** Wake a chef that was just handed its appliances, for targeted. The time is only for the simulation's callback. */
+static void wakeChef( ChefRec *chef, long long now )
+{
+  (void) now;
+  pthread_cond_signal( &chef->cond );
+}
+
+/** Take the chef's appliances if the policy lets it, otherwise get in line until someone hands them over. */
+static void targetedAcquire( ChefRec *chef )
+{
+  pthread_mutex_lock( &lock );
+
+  long long now = policy == POLICY_GREEDY ? 0 : microTime();
+  if ( !takeNow( chef, now ) ) {
+    getInLine( chef, now );
+    while ( !chef->granted ) {
+      pthread_cond_wait( &chef->cond, &lock );
+      chef->wakeups++;
+      if ( !chef->granted )
+        chef->spurious++;
+    }
+  }
+
+  pthread_mutex_unlock( &lock );
+}
+
+static void targetedRelease( ChefRec *chef )
+{
+  pthread_mutex_lock( &lock );
+  markAppliances( chef, false );
+
+  // hand appliances to the chefs that can have them now, and wake just them
+  grantWaiters( policy == POLICY_GREEDY ? 0 : microTime(), wakeChef );
+
+  pthread_mutex_unlock( &lock );
+}
+
+/** Every way we know of running the kitchen. */
+static Mode const modeList[] = {
+  { "global", globalAcquire, globalRelease, false, MODEL_GLOBAL },
+  { "ordered", orderedAcquire, orderedRelease, false, MODEL_ORDERED },
+  { "takeAll", takeAllAcquire, takeAllRelease, true, MODEL_ALL },
+  { "atomic", atomicAcquire, atomicRelease, true, MODEL_ALL },
+  { "targeted", targetedAcquire, targetedRelease, true, MODEL_ALL },
+};
+
+/** The way we're running the kitchen. */
+static Mode const *mode = &modeList[ 0 ];
+
+/** Start routine for every chef, cooking and resting until we're told to stop. */
+static void *chef( void *arg )
+{
+  // Argument struct, converted to its actual type.
+  ChefRec *rec = (ChefRec *) arg;
+
+  while ( running ) {
+    // Get the appliances this chef uses.
+    mode->acquire( rec );
+
+    cook( rec->cookTime, rec );
+
+    mode->release( rec );
+
+    rest( restTime, rec );
+  }
+
+  return NULL;
+}
+
+/** Events waiting to happen, as a binary heap ordered by time, and how many there are. */
+static Event *eventHeap;
+static int eventCount;
+
+/** Events scheduled so far, for breaking ties. */
+static long eventOrder;
+
+/** Chef holding each appliance lock, or -1, with the global lock after the appliances, for the simulation. */
+static int holder[ MAX_APPLIANCES + 1 ];
+
+/** Chefs waiting for each lock, first and last, for the simulation. */
+static int lockHead[ MAX_APPLIANCES + 1 ];
+static int lockTail[ MAX_APPLIANCES + 1 ];
+
+/** For each chef in the simulation, the chef after it in whatever line it's in, and how many of its locks it holds. */
+static int *nextInLine;
+static int *held;
+
+/** Index the simulation uses for the global lock. */
+static int globalLock[ 1 ] = { MAX_APPLIANCES };
+
+/**
+  * Schedule an event.
+  * @param time when it happens
+  * @param chef index of the chef
+  * @param kind what the chef finishes
+*/
+static void schedule( long long time, int chef, int kind )
+{
+  Event event = { time, eventOrder++, chef, kind };
+
+  // sift up from the end
+  int i = eventCount++;
+  while ( i > 0 ) {
+    Event *parent = &eventHeap[ ( i - 1 ) / 2 ];
+    if ( parent->time < time || ( parent->time == time && parent->order < event.order ) )
+      break;
+    eventHeap[ i ] = *parent;
+    i = ( i - 1 ) / 2;
+  }
+  eventHeap[ i ] = event;
+}
+
+/**
+  * Take the earliest event off the heap.
+  * @return the event
+*/
+static Event nextEvent()
+{
+  Event first = eventHeap[ 0 ];
+  Event last = eventHeap[ --eventCount ];
+
+  // sift the last one down from the top
+  int i = 0;
+  for ( ;; ) {
+    int child = 2 * i + 1;
+    if ( child >= eventCount )
+      break;
+    if ( child + 1 < eventCount &&
+         ( eventHeap[ child + 1 ].time < eventHeap[ child ].time ||
+           ( eventHeap[ child + 1 ].time == eventHeap[ child ].time &&
+             eventHeap[ child + 1 ].order < eventHeap[ child ].order ) ) )
+      child++;
+    if ( last.time < eventHeap[ child ].time ||
+         ( last.time == eventHeap[ child ].time && last.order < eventHeap[ child ].order ) )
+      break;
+    eventHeap[ i ] = eventHeap[ child ];
+    i = child;
+  }
+  eventHeap[ i ] = last;
+
+  return first;
+}
+
+/**
+  * Locks a chef takes one at a time in the simulation, in the order it takes them.
+  * @param c index of the chef
+  * @param count where to store how many there are
+  * @return the list of locks
+*/
+static int const *lockList( int c, int *count )
+{
+  if ( mode->model == MODEL_GLOBAL ) {
+    *count = 1;
+    return globalLock;
+  }
+
+  *count = chefList[ c ].useCount;
+  return chefList[ c ].uses;
+}
+
+/**
+  * Start a chef cooking once it has its appliances, in the simulation.
+  * @param chef the chef
+  * @param now current time
+*/
+static void startCooking( ChefRec *chef, long long now )
+{
+  schedule( now + pickTime( chef->cookTime, chef ), chef - chefList, DONE_COOKING );
+}
+
+/**
+  * Keep taking a chef's locks in order, starting cooking once it has them all, or getting in line for the first one
+  * somebody else holds.
+  * @param c index of the chef
+  * @param now current time
+*/
+static void keepLocking( int c, long long now )
+{
+  int count;
+  int const *locks = lockList( c, &count );
+  while ( held[ c ] < count ) {
+    int l = locks[ held[ c ] ];
+    if ( holder[ l ] != -1 ) {
+      nextInLine[ c ] = -1;
+      if ( lockHead[ l ] == -1 )
+        lockHead[ l ] = c;
+      else
+        nextInLine[ lockTail[ l ] ] = c;
+      lockTail[ l ] = c;
+      return;
+    }
+    holder[ l ] = c;
+    held[ c ]++;
+  }
+
+  startCooking( &chefList[ c ], now );
+}
+
+/**
+  * A chef is done resting and wants its appliances.
+  * @param c index of the chef
+  * @param now current time
+*/
+static void simAcquire( int c, long long now )
+{
+  if ( mode->model != MODEL_ALL ) {
+    held[ c ] = 0;
+    keepLocking( c, now );
+  } else if ( takeNow( &chefList[ c ], now ) ) {
+    startCooking( &chefList[ c ], now );
+  } else {
+    getInLine( &chefList[ c ], now );
+  }
+}
+
+/**
+  * A chef is done cooking and gives back its appliances, to the next chef in line for each lock or, when they're taken
+  * all at once, to the waiting chefs the policy picks, like targeted.
+  * @param c index of the chef
+  * @param now current time
+*/
+static void simRelease( int c, long long now )
+{
+  if ( mode->model != MODEL_ALL ) {
+    int count;
+    int const *locks = lockList( c, &count );
+    for ( int i = count - 1; i >= 0; i-- ) {
+      int l = locks[ i ];
+      int next = lockHead[ l ];
+      holder[ l ] = next;
+      if ( next != -1 ) {
+        lockHead[ l ] = nextInLine[ next ];
+        held[ next ]++;
+        keepLocking( next, now );
+      }
+    }
+    return;
+  }
+
+  markAppliances( &chefList[ c ], false );
+  grantWaiters( now, startCooking );
+}
+
+/**
+  * Run the kitchen in virtual time, counting the dishes each chef finishes by the end.
+  * @param seconds how long to run, in virtual seconds
+  * @param seed seed for the chefs' cooking and resting times
+*/
+static void simulate( int seconds, unsigned seed )
+{
+  long long end = seconds * 1000000LL;
+
+  // every appliance starts out free and unlocked, and every chef starts out wanting its appliances
+  memset( freeMask, 0, sizeof( freeMask ) );
+  for ( int a = 0; a < applianceCount; a++ )
+    freeMask[ a / 64 ] |= 1ULL << ( a % 64 );
+  for ( int l = 0; l <= MAX_APPLIANCES; l++ )
+    holder[ l ] = lockHead[ l ] = lockTail[ l ] = -1;
+  waiters = lastWaiter = NULL;
+  nextTicket = 0;
+  eventCount = 0;
+  eventOrder = 0;
+
+  for ( int c = 0; c < chefCount; c++ ) {
+    chefList[ c ].seed = rand_r( &seed );
+    chefList[ c ].dishCount = 0;
+  }
+  for ( int c = 0; c < chefCount; c++ )
+    simAcquire( c, 0 );
+
+  while ( eventCount > 0 && eventHeap[ 0 ].time <= end ) {
+    Event event = nextEvent();
+    ChefRec *rec = &chefList[ event.chef ];
+    if ( event.kind == DONE_COOKING ) {
+      rec->dishCount++;
+      simRelease( event.chef, event.time );
+      schedule( event.time + pickTime( restTime, rec ), event.chef, DONE_RESTING );
+    } else {
+      simAcquire( event.chef, event.time );
+    }
+  }
+}
+
+/**
+  * Print the fewest and most dishes any chef cooked, and Jain's fairness index, which is 1 when every chef cooked the
+  * same number and 1 / chefCount when one chef cooked them all.
+  * @param dishes dishes each chef cooked
+*/
+static void printFairness( double const *dishes )
+{
+  int fewest = 0, most = 0;
+  double sum = 0, squares = 0;
+  for ( int c = 0; c < chefCount; c++ ) {
+    if ( dishes[ c ] < dishes[ fewest ] )
+      fewest = c;
+    if ( dishes[ c ] > dishes[ most ] )
+      most = c;
+    sum += dishes[ c ];
+    squares += dishes[ c ] * dishes[ c ];
+  }
+
+  printf( "Fewest dishes: %.1f ( %s ), most: %.1f ( %s )\n", dishes[ fewest ], chefList[ fewest ].name,
+          dishes[ most ], chefList[ most ].name );
+  printf( "Jain's fairness index: %.3f\n", squares > 0 ? sum * sum / ( chefCount * squares ) : 1.0 );
+}
+
+/**
+  * Find an appliance by name, adding it if we haven't seen it.
+  * @param name name of the appliance
+  * @return its index in applianceName
+*/
+static int findAppliance( char const *name )
+{
+  for ( int i = 0; i < applianceCount; i++ )
+    if ( strcmp( applianceName[ i ], name ) == 0 )
+      return i;
+
+  if ( applianceCount == MAX_APPLIANCES )
+    fail( "Too many appliances" );
+  if ( strlen( name ) >= NAME_LIMIT )
+    fail( "Appliance name too long" );
+  strcpy( applianceName[ applianceCount ], name );
+  return applianceCount++;
+}
+
+/**
+  * Add a chef from a line like "Mandy 105 coffeeMaker microwave". Blank lines and lines starting with # are skipped.
+  * @param line the line, which gets broken up into words
+*/
+static void addChef( char *line )
+{
+  char *word = strtok( line, " \t\r\n" );
+  if ( !word || word[ 0 ] == '#' )
+    return;
+
+  chefList = (ChefRec *) realloc( chefList, ( chefCount + 1 ) * sizeof( ChefRec ) );
+  if ( !chefList )
+    fail( "Out of memory" );
+  ChefRec *rec = &chefList[ chefCount++ ];
+  memset( rec, 0, sizeof( ChefRec ) );
+
+  if ( strlen( word ) >= NAME_LIMIT )
+    fail( "Chef name too long" );
+  strcpy( rec->name, word );
+
+  word = strtok( NULL, " \t\r\n" );
+  if ( !word || sscanf( word, "%d", &rec->cookTime ) != 1 || rec->cookTime < 1 )
+    fail( "Bad cook time" );
+
+  // for now uses holds the order the appliances were first seen in, sortAppliances fixes it up
+  while ( ( word = strtok( NULL, " \t\r\n" ) ) ) {
+    int a = findAppliance( word );
+    bool seen = false;
+    for ( int i = 0; i < rec->useCount; i++ )
+      seen = seen || rec->uses[ i ] == a;
+    if ( !seen )
+      rec->uses[ rec->useCount++ ] = a;
+  }
+}
+
+/** Comparison function for sorting appliance names. */
+static int compareNames( void const *a, void const *b )
+{
+  return strcmp( applianceName[ *(int const *) a ], applianceName[ *(int const *) b ] );
+}
+
+/** Comparison function for sorting appliance indexes. */
+static int compareInts( void const *a, void const *b )
+{
+  return *(int const *) a - *(int const *) b;
+}
+
+/** Put the appliances in alphabetical order, and build each chef's list and bitmask from that order. */
+static void sortAppliances()
+{
+  int order[ MAX_APPLIANCES ];
+  for ( int i = 0; i < applianceCount; i++ )
+    order[ i ] = i;
+  qsort( order, applianceCount, sizeof( int ), compareNames );
+
+  // rank[ a ] is where appliance a ends up
+  int rank[ MAX_APPLIANCES ];
+  char sorted[ MAX_APPLIANCES ][ NAME_LIMIT ];
+  for ( int i = 0; i < applianceCount; i++ ) {
+    rank[ order[ i ] ] = i;
+    strcpy( sorted[ i ], applianceName[ order[ i ] ] );
+  }
+  for ( int i = 0; i < applianceCount; i++ )
+    strcpy( applianceName[ i ], sorted[ i ] );
+
+  for ( int c = 0; c < chefCount; c++ ) {
+    ChefRec *rec = &chefList[ c ];
+    for ( int i = 0; i < rec->useCount; i++ ) {
+      rec->uses[ i ] = rank[ rec->uses[ i ] ];
+      rec->need[ rec->uses[ i ] / 64 ] |= 1ULL << ( rec->uses[ i ] % 64 );
+    }
+    qsort( rec->uses, rec->useCount, sizeof( int ), compareInts );
+  }
+}
+
+/**
+  * Read our chefs from a kitchen file.
+  * @param path name of the file
+*/
+static void readKitchen( char const *path )
+{
+  FILE *fp = fopen( path, "r" );
+  if ( !fp )
+    fail( "Can't open kitchen file" );
+
+  char line[ LINE_LIMIT ];
+  while ( fgets( line, sizeof( line ), fp ) )
+    addChef( line );
+  fclose( fp );
+}
+
+/**
+  * Make up a kitchen, each chef needing a few different appliances picked at random and 15 to 105 milliseconds a dish
+  * like our usual chefs.
+  * @param chefs number of chefs
+  * @param appliances number of appliances
+  * @param perChef number of appliances each chef needs
+*/
+static void makeKitchen( int chefs, int appliances, int perChef )
+{
+  unsigned seed = 1;
+  for ( int c = 0; c < chefs; c++ ) {
+    char line[ LINE_LIMIT ];
+    int n = snprintf( line, sizeof( line ), "chef%d %d", c, 15 * ( 1 + rand_r( &seed ) % 7 ) );
+
+    // pick perChef different appliances, zero padded so alphabetical order is numeric order
+    bool taken[ MAX_APPLIANCES ] = { false };
+    for ( int i = 0; i < perChef; i++ ) {
+      int a;
+      do {
+        a = rand_r( &seed ) % appliances;
+      } while ( taken[ a ] );
+      taken[ a ] = true;
+      n += snprintf( line + n, sizeof( line ) - n, " appliance%03d", a );
+    }
+
+    addChef( line );
+  }
+}
+
+int main( int argc, char *argv[] )
+{
+  int seconds = 10;
+  char const *path = NULL;
+  int chefs = 0, appliances = 0, perChef = 0;
+  bool simulated = false;
+  int runs = 1;
+  char const *const policyName[] = { "greedy", "fifo", "aging", "shortest" };
+
+  // Seed the random number generator, so we get variation in behavior.
+  unsigned seed = time( NULL );
+
+  for ( int i = 1; i < argc; i++ ) {
+    if ( strcmp( argv[ i ], "-q" ) == 0 ) {
+      verbose = false;
+    } else if ( strcmp( argv[ i ], "-m" ) == 0 && i + 1 < argc ) {
+      mode = NULL;
+      for ( size_t m = 0; m < sizeof( modeList ) / sizeof( modeList[ 0 ] ); m++ )
+        if ( strcmp( argv[ i + 1 ], modeList[ m ].name ) == 0 )
+          mode = &modeList[ m ];
+      if ( !mode )
+        usage();
+      i++;
+    } else if ( strcmp( argv[ i ], "-f" ) == 0 && i + 1 < argc ) {
+      path = argv[ ++i ];
+    } else if ( strcmp( argv[ i ], "-g" ) == 0 && i + 3 < argc ) {
+      if ( sscanf( argv[ i + 1 ], "%d", &chefs ) != 1 || sscanf( argv[ i + 2 ], "%d", &appliances ) != 1 ||
+           sscanf( argv[ i + 3 ], "%d", &perChef ) != 1 || chefs < 1 || appliances < 1 ||
+           appliances > MAX_APPLIANCES || perChef < 1 || perChef > appliances )
+        usage();
+      i += 3;
+    } else if ( strcmp( argv[ i ], "-t" ) == 0 && i + 1 < argc ) {
+      if ( sscanf( argv[ ++i ], "%d", &seconds ) != 1 || seconds < 1 )
+        usage();
+    } else if ( strcmp( argv[ i ], "-p" ) == 0 && i + 1 < argc ) {
+      policy = -1;
+      for ( size_t p = 0; p < sizeof( policyName ) / sizeof( policyName[ 0 ] ); p++ )
+        if ( strcmp( argv[ i + 1 ], policyName[ p ] ) == 0 )
+          policy = p;
+      if ( policy == -1 )
+        usage();
+      i++;
+    } else if ( strcmp( argv[ i ], "-b" ) == 0 && i + 1 < argc ) {
+      if ( sscanf( argv[ ++i ], "%d", &bound ) != 1 || bound < 0 )
+        usage();
+    } else if ( strcmp( argv[ i ], "-s" ) == 0 ) {
+      simulated = true;
+    } else if ( strcmp( argv[ i ], "-n" ) == 0 && i + 1 < argc ) {
+      if ( sscanf( argv[ ++i ], "%d", &runs ) != 1 || runs < 1 )
+        usage();
+    } else if ( strcmp( argv[ i ], "-S" ) == 0 && i + 1 < argc ) {
+      if ( sscanf( argv[ ++i ], "%u", &seed ) != 1 )
+        usage();
+    } else if ( strcmp( argv[ i ], "-r" ) == 0 && i + 1 < argc ) {
+      if ( sscanf( argv[ ++i ], "%d", &restTime ) != 1 || restTime < 0 )
+        usage();
+    } else {
+      usage();
+    }
+  }
+
+  // the others don't keep a line of waiting chefs to choose from
+  if ( policy != POLICY_GREEDY && mode->acquire != targetedAcquire )
+    fail( "Policies only work with targeted" );
+
+  // Make a record for each chef.
+  if ( path ) {
+    readKitchen( path );
+  } else if ( chefs ) {
+    makeKitchen( chefs, appliances, perChef );
+  } else {
+    for ( size_t i = 0; i < sizeof( defaultKitchen ) / sizeof( defaultKitchen[ 0 ] ); i++ ) {
+      char line[ LINE_LIMIT ];
+      strcpy( line, defaultKitchen[ i ] );
+      addChef( line );
+    }
+  }
+
+  if ( chefCount == 0 )
+    fail( "No chefs" );
+  sortAppliances();
+
+  // Run the kitchen in virtual time instead, once for each seed, and report the average.
+  if ( simulated ) {
+    eventHeap = (Event *) malloc( chefCount * sizeof( Event ) );
+    nextInLine = (int *) malloc( chefCount * sizeof( int ) );
+    held = (int *) malloc( chefCount * sizeof( int ) );
+    double *dishes = (double *) calloc( chefCount, sizeof( double ) );
+    if ( !eventHeap || !nextInLine || !held || !dishes )
+      fail( "Out of memory" );
+
+    double sum = 0, squares = 0;
+    for ( int r = 0; r < runs; r++ ) {
+      simulate( seconds, seed + r );
+      int total = 0;
+      for ( int c = 0; c < chefCount; c++ ) {
+        dishes[ c ] += chefList[ c ].dishCount;
+        total += chefList[ c ].dishCount;
+      }
+      sum += total;
+      squares += (double) total * total;
+    }
+
+    for ( int c = 0; c < chefCount; c++ )
+      printf( "%s cooked %.1f dishes\n", chefList[ c ].name, dishes[ c ] / runs );
+    double mean = sum / runs;
+    printf( "Total dishes cooked: %.1f", mean );
+    if ( runs > 1 )
+      printf( " ( mean of %d runs, standard deviation %.1f )", runs,
+              sqrt( squares / runs - mean * mean > 0 ? squares / runs - mean * mean : 0 ) );
+    printf( "\n" );
+    printf( "Dishes per second: %.1f\n", mean / seconds );
+    for ( int c = 0; c < chefCount; c++ )
+      dishes[ c ] /= runs;
+    printFairness( dishes );
+
+    free( eventHeap );
+    free( nextInLine );
+    free( held );
+    free( dishes );
+    free( chefList );
+    return 0;
+  }
+
+  // Every appliance starts out free and unlocked.
+  for ( int a = 0; a < applianceCount; a++ ) {
+    pthread_mutex_init( &applianceLock[ a ], NULL );
+    freeMask[ a / 64 ] |= 1ULL << ( a % 64 );
+  }
+  // the atomic word only has room for 64 appliances
+  if ( mode->acquire == atomicAcquire && applianceCount > 64 )
+    fail( "Too many appliances for atomic" );
+  atomic_store( &freeWord, freeMask[ 0 ] );
+
+  // Make a thread for each chef.
+  for ( int i = 0; i < chefCount; i++ ) {
+    chefList[ i ].seed = rand_r( &seed );
+    pthread_cond_init( &chefList[ i ].cond, NULL );
+    // Give each chef a pointer to its ChefRec struct.
+    if ( pthread_create( &chefList[ i ].thread,
+                         NULL,
+                         chef,
+                         chefList + i ) != 0 )
+      fail( "Can't create thread" );
+  }
+
+  // Let the chefs cook for a while, then ask them to stop.
+  sleep( seconds );
+  running = false;
+
+  // Wait for all our chefs to finish, and collect up how much
+  // cooking was done.
+  int total = 0, wakeups = 0, spurious = 0;
+  double *dishes = (double *) malloc( chefCount * sizeof( double ) );
+  if ( !dishes )
+    fail( "Out of memory" );
+  for ( int i = 0; i < chefCount; i++ ) {
+    pthread_join( chefList[ i ].thread, NULL );
+    printf( "%s cooked %d dishes\n",
+            chefList[ i ].name,
+            chefList[ i ].dishCount );
+    total += chefList[ i ].dishCount;
+    dishes[ i ] = chefList[ i ].dishCount;
+    wakeups += chefList[ i ].wakeups;
+    spurious += chefList[ i ].spurious;
+    pthread_cond_destroy( &chefList[ i ].cond );
+  }
+  printf( "Total dishes cooked: %d\n", total );
+  printf( "Dishes per second: %.1f\n", (double) total / seconds );
+  printFairness( dishes );
+  free( dishes );
+  if ( mode->counted && total > 0 )
+    printf( "Wakeups per dish: %.2f ( %.2f found their appliances still busy )\n",
+            (double) wakeups / total, (double) spurious / total );
+
+  free( chefList );
+  return 0;
+}
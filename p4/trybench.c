@@ -0,0 +1,208 @@
+/**
+  * @file trybench.c
+  * @author Jake Donovan (jmpatte8)
+  * Benchmark for the hall monitor's ways of asking for space. We time the fast path, where there is room and
+  * allocateSpace or tryAllocateSpace returns right away, against the paths that can't get space: tryAllocateSpace
+  * saying no, allocateSpaceTimed giving up at its deadline, and allocateSpace waiting for another thread to hand space
+  * over. The monitor logs to /dev/null through its event log so printing stays out of the timings. Compile with hall.c
+  * and eventlog.c.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include "hall.h"
+
+// Number of calls to time for each path when we aren't told otherwise.
+#define DEFAULT_COUNT 20000
+
+// Spaces in the hall.
+#define HALL_SIZE 64
+
+// Microseconds allocateSpaceTimed is given before it gives up.
+#define TIMEOUT_US 50
+
+// Print out an error message and exit.
+static void fail( char const *message ) {
+    fprintf( stderr, "%s\n", message );
+    exit( 1 );
+}
+
+// Print out a usage message and exit.
+static void usage() {
+    fprintf( stderr, "usage: trybench [<calls>]\n" );
+    exit( 1 );
+}
+
+/**
+  * Current time in nanoseconds.
+  * @return monotonic clock reading
+*/
+static long long nanoTime() {
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+/** Comparison function for sorting latencies. */
+static int compareTimes( void const *a, void const *b ) {
+    long long x = *( long long const * )a;
+    long long y = *( long long const * )b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+  * Print latency percentiles for one path.
+  * @param label name of the path
+  * @param times latency of each call, sorted by this function
+  * @param count number of calls
+*/
+static void report( char const *label, long long *times, int count ) {
+    qsort( times, count, sizeof( long long ), compareTimes );
+    printf( "%-28s p50 %9.2f us  p99 %9.2f us  max %9.2f us\n", label, times[ count / 2 ] / 1e3,
+            times[ ( int )( count * 0.99 ) ] / 1e3, times[ count - 1 ] / 1e3 );
+}
+
+/** Number of handoffs for the blocking path */
+static int handoffs;
+
+/**
+  * Start routine for the other side of the blocking path. Takes the whole hall, then lets the main thread
+  * in, over and over, so every allocateSpace it makes has to wait.
+  * @param arg where to store the time it freed the hall each time
+*/
+static void *partner( void *arg ) {
+    long long *freedAt = ( long long * )arg;
+    for( int i = 0; i < handoffs; i++ ) {
+        int start = allocateSpace( "Partner", HALL_SIZE );
+
+        // give the main thread time to start waiting again
+        usleep( 100 );
+        freedAt[ i ] = nanoTime();
+        freeSpace( "Partner", start, HALL_SIZE );
+    }
+
+    return NULL;
+}
+
+/**
+  * Program starting point. Times each path in turn.
+  * @param argc the number of command line arguments
+  * @param argv a char pointer to an array of command line arguments
+  * @return program exit status
+*/
+int main( int argc, char *argv[] ) {
+    int count = DEFAULT_COUNT;
+    if( argc > 2 || ( argc > 1 && ( sscanf( argv[ 1 ], "%d", &count ) != 1 || count < 1 ) ) ) {
+        usage();
+    }
+
+    long long *times = ( long long * )malloc( count * sizeof( long long ) );
+    long long *freedAt = ( long long * )malloc( count * sizeof( long long ) );
+    if( !times || !freedAt ) {
+        fail( "Out of memory" );
+    }
+
+    // keep the monitor's messages out of the results
+    fflush( stdout );
+    int saved = dup( STDOUT_FILENO );
+    int devNull = open( "/dev/null", O_WRONLY );
+    if( saved == -1 || devNull == -1 ) {
+        fail( "Can't redirect output" );
+    }
+    dup2( devNull, STDOUT_FILENO );
+    close( devNull );
+
+    initMonitor( HALL_SIZE );
+    setLogMode( LOG_DIFF );
+
+    // fast paths, the hall is empty so every call gets space right away
+    long long *fastBlocking = ( long long * )malloc( count * sizeof( long long ) );
+    for( int i = 0; i < count; i++ ) {
+        long long start = nanoTime();
+        int at = allocateSpace( "Fast", 4 );
+        fastBlocking[ i ] = nanoTime() - start;
+        freeSpace( "Fast", at, 4 );
+    }
+
+    long long *fastTry = ( long long * )malloc( count * sizeof( long long ) );
+    for( int i = 0; i < count; i++ ) {
+        long long start = nanoTime();
+        int at = tryAllocateSpace( "Fast", 4 );
+        fastTry[ i ] = nanoTime() - start;
+        if( at == -1 ) {
+            fail( "tryAllocateSpace failed in an empty hall" );
+        }
+        freeSpace( "Fast", at, 4 );
+    }
+
+    // the hall is full, so the next calls can't get space
+    int full = allocateSpace( "Full", HALL_SIZE );
+    long long *refused = ( long long * )malloc( count * sizeof( long long ) );
+    for( int i = 0; i < count; i++ ) {
+        long long start = nanoTime();
+        if( tryAllocateSpace( "Refused", 1 ) != -1 ) {
+            fail( "tryAllocateSpace got space in a full hall" );
+        }
+        refused[ i ] = nanoTime() - start;
+    }
+
+    // timed waits are slow, so fewer of them, timed past the deadline they were given
+    int timedCount = count / 10 > 0 ? count / 10 : 1;
+    long long *late = ( long long * )malloc( timedCount * sizeof( long long ) );
+    for( int i = 0; i < timedCount; i++ ) {
+        struct timespec deadline;
+        clock_gettime( CLOCK_MONOTONIC, &deadline );
+        long long due = deadline.tv_sec * 1000000000LL + deadline.tv_nsec + TIMEOUT_US * 1000LL;
+        deadline.tv_sec = due / 1000000000LL;
+        deadline.tv_nsec = due % 1000000000LL;
+        if( allocateSpaceTimed( "Timed", 1, &deadline ) != -1 ) {
+            fail( "allocateSpaceTimed got space in a full hall" );
+        }
+        late[ i ] = nanoTime() - due;
+    }
+    freeSpace( "Full", full, HALL_SIZE );
+
+    // blocking path, timed from when the partner frees the hall until allocateSpace returns here
+    handoffs = timedCount;
+    pthread_t thread;
+    if( pthread_create( &thread, NULL, partner, freedAt ) != 0 ) {
+        fail( "Can't create thread" );
+    }
+    for( int i = 0; i < handoffs; i++ ) {
+        // wait for the partner to take the hall, so our allocateSpace has to wait
+        MonitorStats stats;
+        do {
+            getMonitorStats( &stats );
+        } while( stats.freeSpaces != 0 );
+
+        int at = allocateSpace( "Blocked", HALL_SIZE );
+        times[ i ] = nanoTime() - freedAt[ i ];
+        freeSpace( "Blocked", at, HALL_SIZE );
+    }
+    pthread_join( thread, NULL );
+    destroyMonitor();
+
+    fflush( stdout );
+    dup2( saved, STDOUT_FILENO );
+    close( saved );
+
+    printf( "calls: %d  timed and blocking calls: %d  hall: %d spaces\n", count, timedCount, HALL_SIZE );
+    report( "allocateSpace, room", fastBlocking, count );
+    report( "tryAllocateSpace, room", fastTry, count );
+    report( "tryAllocateSpace, full", refused, count );
+    report( "allocateSpaceTimed, past due", late, timedCount );
+    report( "allocateSpace, handoff", times, handoffs );
+
+    free( times );
+    free( freedAt );
+    free( fastBlocking );
+    free( fastTry );
+    free( refused );
+    free( late );
+    return 0;
+}